@@ -0,0 +1,467 @@
+#include "APU.h"
+#include <string.h>
+
+// NRx0 through NRx4 of channel n are at 0xFF10 + 5n
+#define NR(n, x) (0xFF10 + (n) * 5 + (x))
+
+// the bits that read back as 1, 0xFF10 to 0xFF2F
+static uint8_t const read_masks[0x20] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF,
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,
+    0x00, 0x00, 0x70,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+static uint8_t const duties[4] = {0x01, 0x81, 0x87, 0x7E};
+static int const noise_divisors[8] = {8, 16, 32, 48, 64, 80, 96, 112};
+
+APU::APU(int sample_rate) :
+    left(CLOCK_RATE, sample_rate, sample_rate / 10),
+    right(CLOCK_RATE, sample_rate, sample_rate / 10) {
+}
+
+void APU::init(CPU *cpu) {
+    this->cpu = cpu;
+    left.clear();
+    right.clear();
+    memset(out, 0, sizeof(out));
+    memset(gain, 0, sizeof(gain));
+    output.clear();
+}
+
+int APU::getSampleRate() {
+    return left.getSampleRate();
+}
+
+void APU::setRatio(double ratio) {
+    left.setRatio(ratio);
+    right.setRatio(ratio);
+}
+
+bool APU::dacOn(int n) {
+    if (n == 2)
+        return reg(0xFF1A) & 0x80;
+    return reg(NR(n, 2)) & 0xF8;
+}
+
+// dots per waveform step
+int APU::period(int n) {
+    if (n == 3) {
+        int shift = reg(0xFF22) >> 4;
+        return noise_divisors[reg(0xFF22) & 7] << shift;
+    }
+    int freq = reg(NR(n, 3)) | ((reg(NR(n, 4)) & 7) << 8);
+    return (2048 - freq) * (n == 2 ? 2 : 4);
+}
+
+// What channel n is putting out right now, 0-15.
+int APU::level(int n) {
+    SoundChannel &c = cpu->state->apu.ch[n];
+    if (!c.enabled)
+        return 0;
+
+    switch (n) {
+        case 0:
+        case 1:
+            return (duties[reg(NR(n, 1)) >> 6] >> c.pos) & 1 ? c.volume : 0;
+        case 2: {
+            int shift = (reg(0xFF1C) >> 5) & 3;
+            if (shift == 0)
+                return 0;
+            uint8_t sample = reg(0xFF30 + c.pos / 2);
+            sample = c.pos & 1 ? sample & 0x0f : sample >> 4;
+            return sample >> (shift - 1);
+        }
+        default:
+            return cpu->state->apu.lfsr & 1 ? 0 : c.volume;
+    }
+}
+
+void APU::setLevel(int n, int at) {
+    if (!synth && !hash)
+        return;
+
+    int now = level(n);
+    int delta = now - out[n];
+    if (delta == 0)
+        return;
+
+    out[n] = now;
+    if (hash)
+        fold(at, n, now);
+    if (!synth)
+        return;
+    if (gain[n][0])
+        left.addDelta(at, delta * gain[n][0]);
+    if (gain[n][1])
+        right.addDelta(at, delta * gain[n][1]);
+}
+
+// out and gain aren't part of the machine state, they're worked out again
+// from it whenever it gets swapped underneath the APU (loading a state,
+// rewinding, forking). The jump in level goes into the blip buffers so the
+// sound carries on from the new state the way it would have played.
+void APU::resync() {
+    int before[2] = {}, after[2] = {};
+    for (int n=0; n<4; n++) {
+        before[0] += out[n] * gain[n][0];
+        before[1] += out[n] * gain[n][1];
+        out[n] = level(n);
+        gains(n, gain[n]);
+        after[0] += out[n] * gain[n][0];
+        after[1] += out[n] * gain[n][1];
+    }
+    if (synth) {
+        left.allocate();
+        right.allocate();
+        if (after[0] != before[0])
+            left.addDelta(0, after[0] - before[0]);
+        if (after[1] != before[1])
+            right.addDelta(0, after[1] - before[1]);
+    }
+}
+
+void APU::updateLevels() {
+    for (int n=0; n<4; n++)
+        setLevel(n, 0);
+}
+
+// NR50 master volume times NR51 panning, with headroom for all four
+// channels at full volume.
+void APU::gains(int n, int now[2]) {
+    uint8_t NR50 = reg(0xFF24), NR51 = reg(0xFF25);
+    now[0] = (NR51 >> (4 + n)) & 1 ? (((NR50 >> 4) & 7) + 1) * 64 : 0;
+    now[1] = (NR51 >> n) & 1 ? ((NR50 & 7) + 1) * 64 : 0;
+}
+
+void APU::updateGains() {
+    for (int n=0; n<4; n++) {
+        int now[2];
+        gains(n, now);
+        if (hash && (now[0] != gain[n][0] || now[1] != gain[n][1]))
+            fold(0, 4 + n, (now[0] / 64) << 4 | now[1] / 64);
+        if (synth && out[n] != 0) {
+            if (now[0] != gain[n][0])
+                left.addDelta(0, out[n] * (now[0] - gain[n][0]));
+            if (now[1] != gain[n][1])
+                right.addDelta(0, out[n] * (now[1] - gain[n][1]));
+        }
+        gain[n][0] = now[0];
+        gain[n][1] = now[1];
+    }
+}
+
+void APU::runSquare(int n, int dots) {
+    SoundChannel &c = cpu->state->apu.ch[n];
+    if (!c.enabled)
+        return;
+
+    int step = period(n);
+    if (!synth && !hash) {
+        if (c.timer > dots) {
+            c.timer -= dots;
+        } else {
+            int steps = (dots - c.timer) / step + 1;
+            c.pos = (c.pos + steps) & 7;
+            c.timer += steps * step - dots;
+        }
+        return;
+    }
+
+    int t = c.timer;
+    while (t <= dots) {
+        c.pos = (c.pos + 1) & 7;
+        setLevel(n, t);
+        t += step;
+    }
+    c.timer = t - dots;
+}
+
+void APU::runWave(int dots) {
+    SoundChannel &c = cpu->state->apu.ch[2];
+    if (!c.enabled)
+        return;
+
+    int step = period(2);
+    if (!synth && !hash) {
+        if (c.timer > dots) {
+            c.timer -= dots;
+        } else {
+            int steps = (dots - c.timer) / step + 1;
+            c.pos = (c.pos + steps) & 31;
+            c.timer += steps * step - dots;
+        }
+        return;
+    }
+
+    int t = c.timer;
+    while (t <= dots) {
+        c.pos = (c.pos + 1) & 31;
+        setLevel(2, t);
+        t += step;
+    }
+    c.timer = t - dots;
+}
+
+void APU::runNoise(int dots) {
+    APUState &s = cpu->state->apu;
+    SoundChannel &c = s.ch[3];
+    if (!c.enabled || (reg(0xFF22) >> 4) >= 14)
+        return;
+
+    bool narrow = reg(0xFF22) & 0x08;
+    int step = period(3);
+    int t = c.timer;
+    while (t <= dots) {
+        int bit = (s.lfsr ^ (s.lfsr >> 1)) & 1;
+        s.lfsr = (s.lfsr >> 1) | (bit << 14);
+        if (narrow)
+            s.lfsr = (s.lfsr & ~0x40) | (bit << 6);
+        setLevel(3, t);
+        t += step;
+    }
+    c.timer = t - dots;
+}
+
+int APU::sweepFrequency() {
+    APUState &s = cpu->state->apu;
+    uint8_t NR10 = reg(0xFF10);
+    int change = s.shadow_freq >> (NR10 & 7);
+    int freq = NR10 & 0x08 ? s.shadow_freq - change : s.shadow_freq + change;
+    if (freq > 2047)
+        s.ch[0].enabled = false;
+    return freq;
+}
+
+// 512 Hz: length at 256 Hz, sweep at 128 Hz, envelopes at 64 Hz.
+void APU::clockSequencer() {
+    APUState &s = cpu->state->apu;
+
+    if (s.seq_step % 2 == 0) {
+        for (int n=0; n<4; n++) {
+            SoundChannel &c = s.ch[n];
+            if ((reg(NR(n, 4)) & 0x40) && c.length > 0 && --c.length == 0)
+                c.enabled = false;
+        }
+    }
+
+    if (s.seq_step == 2 || s.seq_step == 6) {
+        uint8_t NR10 = reg(0xFF10);
+        int sweep_period = (NR10 >> 4) & 7;
+        if (--s.sweep_timer <= 0) {
+            s.sweep_timer = sweep_period ? sweep_period : 8;
+            if (s.sweep_enabled && sweep_period) {
+                int freq = sweepFrequency();
+                if (freq <= 2047 && (NR10 & 7)) {
+                    s.shadow_freq = freq;
+                    reg(0xFF13) = freq & 0xff;
+                    reg(0xFF14) = (reg(0xFF14) & ~7) | (freq >> 8);
+                    sweepFrequency();
+                }
+            }
+        }
+    }
+
+    if (s.seq_step == 7) {
+        for (int n=0; n<4; n++) {
+            if (n == 2)
+                continue;
+            SoundChannel &c = s.ch[n];
+            uint8_t NRx2 = reg(NR(n, 2));
+            if ((NRx2 & 7) == 0)
+                continue;
+            if (--c.env_timer <= 0) {
+                c.env_timer = NRx2 & 7;
+                if ((NRx2 & 0x08) && c.volume < 15)
+                    c.volume++;
+                else if (!(NRx2 & 0x08) && c.volume > 0)
+                    c.volume--;
+            }
+        }
+    }
+
+    s.seq_step = (s.seq_step + 1) & 7;
+    updateLevels();
+}
+
+void APU::catchUp() {
+    if (synth) {
+        left.allocate();
+        right.allocate();
+    }
+    APUState &s = cpu->state->apu;
+    int dots = s.pending;
+    s.pending = 0;
+
+    while (dots > 0) {
+        int n = dots < s.seq_timer ? dots : s.seq_timer;
+        runSquare(0, n);
+        runSquare(1, n);
+        runWave(n);
+        runNoise(n);
+        if (synth) {
+            left.advance(n);
+            right.advance(n);
+        }
+        if (hash)
+            frame_dots += n;
+
+        dots -= n;
+        s.seq_timer -= n;
+        if (s.seq_timer == 0) {
+            s.seq_timer = 8192;
+            clockSequencer();
+        }
+
+        if (synth && left.samplesAvailable() > left.capacity() / 2)
+            drain();
+    }
+}
+
+void APU::trigger(int n) {
+    APUState &s = cpu->state->apu;
+    SoundChannel &c = s.ch[n];
+
+    c.enabled = dacOn(n);
+    if (c.length == 0)
+        c.length = n == 2 ? 256 : 64;
+    c.timer = period(n);
+
+    if (n == 2) {
+        c.pos = 0;
+    } else {
+        c.volume = reg(NR(n, 2)) >> 4;
+        c.env_timer = reg(NR(n, 2)) & 7;
+    }
+
+    if (n == 3)
+        s.lfsr = 0x7fff;
+
+    if (n == 0) {
+        uint8_t NR10 = reg(0xFF10);
+        int sweep_period = (NR10 >> 4) & 7;
+        s.shadow_freq = reg(0xFF13) | ((reg(0xFF14) & 7) << 8);
+        s.sweep_timer = sweep_period ? sweep_period : 8;
+        s.sweep_enabled = sweep_period || (NR10 & 7);
+        if (NR10 & 7)
+            sweepFrequency();
+    }
+}
+
+void APU::powerOff() {
+    APUState &s = cpu->state->apu;
+    for (uint16_t address=0xFF10; address<0xFF26; address++)
+        reg(address) = 0;
+    for (int n=0; n<4; n++)
+        s.ch[n].enabled = false;
+}
+
+uint8_t APU::read(uint16_t address) {
+    if (address >= 0xFF30)
+        return reg(address);
+
+    if (address == 0xFF26) {
+        catchUp();
+        APUState &s = cpu->state->apu;
+        uint8_t status = reg(0xFF26) & 0x80;
+        for (int n=0; n<4; n++) {
+            if (s.ch[n].enabled)
+                status |= 1 << n;
+        }
+        return status | 0x70;
+    }
+
+    return reg(address) | read_masks[address - 0xFF10];
+}
+
+void APU::write(uint16_t address, uint8_t value) {
+    catchUp();
+    APUState &s = cpu->state->apu;
+
+    if (address >= 0xFF30) {
+        reg(address) = value;
+        updateLevels();
+        return;
+    }
+
+    if (address == 0xFF26) {
+        bool was_on = reg(0xFF26) & 0x80;
+        if (was_on && !(value & 0x80))
+            powerOff();
+        if (!was_on && (value & 0x80))
+            s.seq_step = 0;
+        reg(0xFF26) = value & 0x80;
+        updateGains();
+        updateLevels();
+        return;
+    }
+
+    // while the APU is off only NR52 can be written
+    if (!(reg(0xFF26) & 0x80) || address > 0xFF26)
+        return;
+    reg(address) = value;
+
+    switch (address) {
+        case 0xFF11: s.ch[0].length = 64 - (value & 0x3f); break;
+        case 0xFF16: s.ch[1].length = 64 - (value & 0x3f); break;
+        case 0xFF1B: s.ch[2].length = 256 - value; break;
+        case 0xFF20: s.ch[3].length = 64 - (value & 0x3f); break;
+        case 0xFF12:
+        case 0xFF17:
+        case 0xFF21:
+            if (!(value & 0xF8))
+                s.ch[(address - 0xFF10) / 5].enabled = false;
+            break;
+        case 0xFF1A:
+            if (!(value & 0x80))
+                s.ch[2].enabled = false;
+            break;
+        case 0xFF14:
+        case 0xFF19:
+        case 0xFF1E:
+        case 0xFF23:
+            if (value & 0x80)
+                trigger((address - 0xFF10) / 5);
+            break;
+        case 0xFF24:
+        case 0xFF25:
+            updateGains();
+            break;
+    }
+    updateLevels();
+}
+
+void APU::drain() {
+    int n = left.samplesAvailable();
+    size_t start = output.size();
+    output.resize(start + 2 * n);
+    left.read(&output[start], n, 2);
+    right.read(&output[start + 1], n, 2);
+}
+
+void APU::beginFrame() {
+    if (synth)
+        output.clear();
+    if (hash) {
+        frame_hash = 14695981039346656037ULL;
+        frame_dots = 0;
+    }
+}
+
+void APU::endFrame() {
+    catchUp();
+    if (synth)
+        drain();
+}
+
+int16_t const *APU::getSamples(size_t *frames) {
+    *frames = output.size() / 2;
+    return output.data();
+}
+
+// of the sound in the last frame, when hash is on
+uint64_t APU::getHash() {
+    return frame_hash;
+}
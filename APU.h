@@ -0,0 +1,86 @@
+#ifndef APU_H
+#define APU_H
+
+#include "CPU.h"
+#include "BlipBuffer.h"
+#include <vector>
+
+#define CLOCK_RATE 4194304
+
+using namespace std;
+
+// Sound. The channels aren't stepped along with the CPU; time just piles up
+// in APUState::pending and they catch up all at once when a sound register
+// is touched or a frame ends. Every change in a channel's output level goes
+// into a BlipBuffer as a band-limited step, so the cost is per edge of the
+// waveform rather than per clock.
+class APU {
+public:
+    APU(int sample_rate = 48000);
+    void init(CPU *cpu);
+
+    inline void advance(int dots) {
+        cpu->state->apu.pending += dots;
+    }
+
+    uint8_t read(uint16_t address);
+    void write(uint16_t address, uint8_t value);
+
+    void resync();
+
+    void beginFrame();
+    void endFrame();
+    // interleaved stereo samples from the last frame
+    int16_t const *getSamples(size_t *frames);
+    int getSampleRate();
+    void setRatio(double ratio);
+
+    // with synth off the channels still run (the game can see their
+    // state) but nothing is mixed or resampled
+    bool synth = true;
+    // hash every change in the channel levels and volumes instead, which
+    // says whether the sound is the same without making any samples
+    bool hash = false;
+    uint64_t getHash();
+
+private:
+    CPU *cpu = NULL;
+    BlipBuffer left;
+    BlipBuffer right;
+    vector<int16_t> output;
+
+    // what the blip buffers were last told about each channel
+    int out[4] = {};
+    int gain[4][2] = {};
+
+    uint64_t frame_hash = 0;
+    int frame_dots = 0;
+    inline void fold(int at, int what, int value) {
+        uint64_t word = ((uint64_t)(frame_dots + at) << 32) | (what << 16) | (uint16_t)value;
+        frame_hash = (frame_hash ^ word) * 1099511628211ULL;
+    }
+
+    inline uint8_t &reg(uint16_t address) {
+        return cpu->state->IO_registers[address - 0xFF00];
+    }
+
+    void catchUp();
+    void drain();
+    void runSquare(int n, int dots);
+    void runWave(int dots);
+    void runNoise(int dots);
+    void clockSequencer();
+    int sweepFrequency();
+
+    int level(int n);
+    void setLevel(int n, int at);
+    void updateLevels();
+    void updateGains();
+    void gains(int n, int now[2]);
+    bool dacOn(int n);
+    int period(int n);
+    void trigger(int n);
+    void powerOff();
+};
+
+#endif
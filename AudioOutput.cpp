@@ -0,0 +1,98 @@
+#include "AudioOutput.h"
+#include <string.h>
+#include <stdio.h>
+
+// how far the ratio may stray from 1, which is well under what anyone
+// can hear as a change in pitch
+#define MAX_RATIO_DELTA 0.005
+
+AudioOutput::AudioOutput(int sample_rate, int latency_ms) :
+    ring((size_t)sample_rate * latency_ms / 1000 * 2), underruns(0) {
+    this->sample_rate = sample_rate;
+    this->latency_ms = latency_ms;
+    target = (size_t)sample_rate * latency_ms / 1000;
+}
+
+AudioOutput::~AudioOutput() {
+    close();
+}
+
+int AudioOutput::open() {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        printf("SDL audio couldn't be initialized: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    // the device buffer is a quarter of the latency so there's always
+    // something queued behind it
+    int samples = 1;
+    while (samples * 2 <= sample_rate * latency_ms / 1000 / 4)
+        samples *= 2;
+
+    SDL_AudioSpec want, have;
+    memset(&want, 0, sizeof(want));
+    want.freq = sample_rate;
+    want.format = AUDIO_S16SYS;
+    want.channels = 2;
+    want.samples = samples;
+    want.callback = callback;
+    want.userdata = this;
+
+    device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if (device == 0) {
+        printf("Audio device couldn't be opened: %s\n", SDL_GetError());
+        return 1;
+    }
+    // stays paused until push has queued enough to start on
+    playing = false;
+    return 0;
+}
+
+void AudioOutput::close() {
+    if (device == 0)
+        return;
+    SDL_CloseAudioDevice(device);
+    device = 0;
+}
+
+// Runs on SDL's audio thread.
+void AudioOutput::callback(void *userdata, Uint8 *stream, int len) {
+    AudioOutput *self = (AudioOutput *)userdata;
+    size_t frames = len / 4;
+    size_t got = self->ring.read((int16_t *)stream, frames);
+    if (got < frames) {
+        memset(stream + got * 4, 0, (frames - got) * 4);
+        self->underruns.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+double AudioOutput::push(int16_t const *samples, size_t frames) {
+    if (device == 0)
+        return 1.0;
+
+    // whatever doesn't fit is dropped (fast forward, mostly)
+    ring.write(samples, frames);
+    if (!playing && ring.size() >= target) {
+        SDL_PauseAudioDevice(device, 0);
+        playing = true;
+    }
+
+    // below the target make a little more sound per frame, above it a
+    // little less
+    double fill = (double)ring.size() / target;
+    ratio = 1.0 + MAX_RATIO_DELTA * (1.0 - fill);
+    if (ratio > 1.0 + MAX_RATIO_DELTA)
+        ratio = 1.0 + MAX_RATIO_DELTA;
+    if (ratio < 1.0 - MAX_RATIO_DELTA)
+        ratio = 1.0 - MAX_RATIO_DELTA;
+    return ratio;
+}
+
+AudioOutput::Stats AudioOutput::stats() {
+    Stats s;
+    s.fill = ring.size();
+    s.fill_ms = (int)(s.fill * 1000 / sample_rate);
+    s.underruns = underruns.load(memory_order_relaxed);
+    s.ratio = ratio;
+    return s;
+}
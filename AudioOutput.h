@@ -0,0 +1,48 @@
+#ifndef AUDIO_OUTPUT_H
+#define AUDIO_OUTPUT_H
+
+#include "SDL.h"
+#include "AudioRing.h"
+#include <atomic>
+
+using namespace std;
+
+// Plays the emulator's sound through SDL. The emulation thread pushes each
+// frame's samples into a lock-free ring that the SDL callback drains, and
+// the resampling ratio is nudged to keep the ring half full, so neither
+// side ever waits on the other and the audio doesn't drift away from the
+// video.
+class AudioOutput {
+public:
+    struct Stats {
+        size_t fill;        // stereo frames queued
+        int fill_ms;
+        uint64_t underruns; // callbacks that ran out of samples
+        double ratio;
+    };
+
+    AudioOutput(int sample_rate, int latency_ms);
+    ~AudioOutput();
+    int open();
+    void close();
+
+    // queues a frame's worth of samples and returns the ratio to resample
+    // the next one at
+    double push(int16_t const *samples, size_t frames);
+    Stats stats();
+
+private:
+    int sample_rate;
+    int latency_ms;
+    SDL_AudioDeviceID device = 0;
+    bool playing = false;
+
+    AudioRing ring;
+    size_t target;      // fill level to aim for, in frames
+    atomic<uint64_t> underruns;
+    double ratio = 1.0;
+
+    static void callback(void *userdata, Uint8 *stream, int len);
+};
+
+#endif
@@ -0,0 +1,53 @@
+#include "AudioRing.h"
+#include <string.h>
+
+AudioRing::AudioRing(size_t capacity) : head(0), tail(0) {
+    size_t n = 1;
+    while (n < capacity)
+        n <<= 1;
+    buffer.resize(2 * n);
+    mask = n - 1;
+}
+
+size_t AudioRing::write(int16_t const *samples, size_t frames) {
+    size_t h = head.load(memory_order_relaxed);
+    size_t t = tail.load(memory_order_acquire);
+    size_t space = capacity() - (h - t);
+    if (frames > space)
+        frames = space;
+
+    // in at most two pieces, around the end of the buffer
+    size_t start = h & mask;
+    size_t first = frames < capacity() - start ? frames : capacity() - start;
+    memcpy(&buffer[2 * start], samples, first * 4);
+    memcpy(&buffer[0], samples + 2 * first, (frames - first) * 4);
+
+    head.store(h + frames, memory_order_release);
+    return frames;
+}
+
+size_t AudioRing::read(int16_t *samples, size_t frames) {
+    size_t t = tail.load(memory_order_relaxed);
+    size_t h = head.load(memory_order_acquire);
+    if (frames > h - t)
+        frames = h - t;
+
+    size_t start = t & mask;
+    size_t first = frames < capacity() - start ? frames : capacity() - start;
+    memcpy(samples, &buffer[2 * start], first * 4);
+    memcpy(samples + 2 * first, &buffer[0], (frames - first) * 4);
+
+    tail.store(t + frames, memory_order_release);
+    return frames;
+}
+
+size_t AudioRing::size() const {
+    // tail first, it can never pass the head read after it
+    size_t t = tail.load(memory_order_acquire);
+    return head.load(memory_order_acquire) - t;
+}
+
+size_t AudioRing::capacity() const {
+    return mask + 1;
+}
+
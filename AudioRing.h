@@ -0,0 +1,37 @@
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+using namespace std;
+
+// Stereo samples passed from one thread to exactly one other without
+// locks: only the writer moves head and only the reader moves tail.
+class AudioRing {
+public:
+    // capacity is in stereo frames and gets rounded up to a power of 2
+    AudioRing(size_t capacity);
+
+    // both return how many frames were actually copied
+    size_t write(int16_t const *samples, size_t frames);
+    size_t read(int16_t *samples, size_t frames);
+
+    size_t size() const;
+    size_t capacity() const;
+
+private:
+    vector<int16_t> buffer;
+    size_t mask;
+    // padded out to their own cache lines so the two threads don't fight
+    // over them (alignas wouldn't be kept by new before C++17)
+    char pad_head[64];
+    atomic<size_t> head;
+    char pad_tail[64 - sizeof(atomic<size_t>)];
+    atomic<size_t> tail;
+    char pad_end[64 - sizeof(atomic<size_t>)];
+};
+
+#endif
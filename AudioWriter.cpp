@@ -0,0 +1,126 @@
+#include "AudioWriter.h"
+#include <string.h>
+
+// samples handed to the writer thread at a time
+#define CHUNK_SAMPLES (1 << 16)
+
+AudioWriter::AudioWriter() {
+}
+
+AudioWriter::~AudioWriter() {
+    close();
+}
+
+int AudioWriter::open(string file, int sample_rate) {
+    close();
+
+    this->file = fopen(file.c_str(), "wb");
+    if (this->file == NULL) {
+        printf("Couldn't open %s for audio\n", file.c_str());
+        return 1;
+    }
+
+    this->sample_rate = sample_rate;
+    wav = file.size() >= 4 && file.compare(file.size() - 4, 4, ".wav") == 0;
+    bytes = 0;
+    failed = false;
+    done = false;
+    if (wav)
+        writeHeader();
+
+    filling.reserve(CHUNK_SAMPLES);
+    flushing.reserve(CHUNK_SAMPLES);
+    writer = thread(&AudioWriter::loop, this);
+    return 0;
+}
+
+void AudioWriter::write(int16_t const *samples, size_t frames) {
+    if (file == NULL)
+        return;
+
+    filling.insert(filling.end(), samples, samples + 2 * frames);
+    if (filling.size() >= CHUNK_SAMPLES)
+        flush();
+}
+
+// Hands the filled buffer over, waiting only if the writer is still busy
+// with the last one.
+void AudioWriter::flush() {
+    unique_lock<mutex> guard(lock);
+    ready.wait(guard, [this] { return flushing.empty(); });
+    filling.swap(flushing);
+    ready.notify_all();
+}
+
+void AudioWriter::loop() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        ready.wait(guard, [this] { return !flushing.empty() || done; });
+        if (flushing.empty())
+            return;
+
+        // the disk write happens without holding the lock
+        guard.unlock();
+        size_t n = fwrite(flushing.data(), sizeof(int16_t), flushing.size(), file);
+        guard.lock();
+        if (n != flushing.size())
+            failed = true;
+        bytes += n * sizeof(int16_t);
+        flushing.clear();
+        ready.notify_all();
+    }
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = v; p[1] = v >> 8;
+}
+
+void AudioWriter::writeHeader() {
+    uint32_t data = bytes > 0xffffffd0 ? 0xffffffd0 : (uint32_t)bytes;
+    uint8_t header[44];
+    memcpy(header, "RIFF", 4);
+    put32(header + 4, 36 + data);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put32(header + 16, 16);
+    put16(header + 20, 1);                  // PCM
+    put16(header + 22, 2);                  // stereo
+    put32(header + 24, sample_rate);
+    put32(header + 28, sample_rate * 4);    // bytes per second
+    put16(header + 32, 4);                  // bytes per frame
+    put16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    put32(header + 40, data);
+    fwrite(header, 1, sizeof(header), file);
+}
+
+int AudioWriter::close() {
+    if (file == NULL)
+        return 0;
+
+    if (!filling.empty())
+        flush();
+    {
+        lock_guard<mutex> guard(lock);
+        done = true;
+    }
+    ready.notify_all();
+    writer.join();
+
+    if (wav) {
+        fseek(file, 0, SEEK_SET);
+        writeHeader();
+    }
+    if (fclose(file) != 0)
+        failed = true;
+    file = NULL;
+
+    if (failed) {
+        printf("Couldn't write all of the audio\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef AUDIO_WRITER_H
+#define AUDIO_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// Writes stereo 16-bit samples to a file on a thread of its own, so the
+// emulator never waits on the disk. Samples collect in one buffer while
+// the other is being written. Files ending in .wav get a WAV header, and
+// anything else is raw little endian PCM.
+class AudioWriter {
+public:
+    AudioWriter();
+    ~AudioWriter();
+    int open(string file, int sample_rate);
+    void write(int16_t const *samples, size_t frames);
+    // flushes everything and fills in the WAV header
+    int close();
+
+private:
+    FILE *file = NULL;
+    bool wav = false;
+    int sample_rate = 0;
+    uint64_t bytes = 0;
+    bool failed = false;
+
+    vector<int16_t> filling;
+    vector<int16_t> flushing;
+    thread writer;
+    mutex lock;
+    condition_variable ready;
+    bool done = false;
+
+    void flush();
+    void loop();
+    void writeHeader();
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "BatchRunner.h"
+
+BatchRunner::BatchRunner(int num_envs, bool color_on, int num_threads) : pool(num_threads) {
+    this->color_on = color_on;
+    for (int i=0; i<num_envs; i++) {
+        envs.push_back(new Emulator(color_on));
+        envs.back()->setSaveFile(false);
+        envs.back()->setAudio(false);
+    }
+}
+
+BatchRunner::~BatchRunner() {
+    for (Emulator *env : envs)
+        delete env;
+    for (FrameObserver *observer : observers)
+        delete observer;
+}
+
+void BatchRunner::setObservation(int width, int height, int stack) {
+    for (FrameObserver *observer : observers)
+        delete observer;
+    observers.clear();
+
+    for (Emulator *env : envs) {
+        env->setGrayscale(true);
+        observers.push_back(new FrameObserver(width, height, stack));
+    }
+}
+
+int BatchRunner::start(string file) {
+    return start(CartridgeImage::open(file, color_on));
+}
+
+// Every game shares the one image.
+int BatchRunner::start(shared_ptr<CartridgeImage> image) {
+    if (!image)
+        return 1;
+
+    atomic<int> failed{0};
+    pool.run(envs.size(), [&](int i) {
+        if (envs[i]->start(image))
+            failed++;
+    });
+    return failed > 0;
+}
+
+void BatchRunner::setRamSpec(RamSpec const &spec) {
+    ram_spec = spec;
+}
+
+void BatchRunner::setAudioHash(bool enabled) {
+    for (Emulator *env : envs)
+        env->setAudioHash(enabled);
+}
+
+void BatchRunner::audioHashes(uint64_t *out) {
+    for (size_t i=0; i<envs.size(); i++)
+        out[i] = envs[i]->getAudioHash();
+}
+
+void BatchRunner::step(uint8_t const *actions, uint8_t *observations, uint8_t *ram) {
+    size_t bytes = observationBytes();
+    size_t ram_bytes = ramBytes();
+    auto begin = chrono::steady_clock::now();
+
+    pool.run(envs.size(), [&](int i) {
+        envs[i]->setButtons(actions[i]);
+        envs[i]->runFrame(true);
+        if (observers.empty())
+            memcpy(observations + i * bytes, envs[i]->getFramebuffer(), bytes);
+        else
+            observers[i]->observe(envs[i]->getGrayFrame(), observations + i * bytes);
+        if (ram != NULL)
+            envs[i]->gather(ram_spec, ram + i * ram_bytes);
+    });
+
+    time_running += chrono::steady_clock::now() - begin;
+    frames_run += envs.size();
+}
+
+int BatchRunner::reset(int env) {
+    if (!observers.empty())
+        observers[env]->reset();
+    return envs[env]->reset();
+}
+
+int BatchRunner::size() {
+    return envs.size();
+}
+
+size_t BatchRunner::observationBytes() {
+    if (!observers.empty())
+        return observers[0]->size();
+    return 160 * 144 * sizeof(uint32_t);
+}
+
+size_t BatchRunner::ramBytes() {
+    return ram_spec.size();
+}
+
+long BatchRunner::framesRun() {
+    return frames_run;
+}
+
+double BatchRunner::framesPerSecond() {
+    double seconds = chrono::duration<double>(time_running).count();
+    return seconds > 0 ? frames_run / seconds : 0;
+}
@@ -0,0 +1,57 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include "Emulator.h"
+#include "ThreadPool.h"
+#include "FrameObserver.h"
+#include <chrono>
+
+using namespace std;
+
+// Lots of independent copies of one game, stepped together a frame at a
+// time on a thread pool (for reinforcement learning, where one process per
+// game is far too much overhead). None of them use a save file.
+class BatchRunner {
+public:
+    BatchRunner(int num_envs, bool color_on, int num_threads = 0);
+    ~BatchRunner();
+
+    int start(string file);
+    int start(shared_ptr<CartridgeImage> image);
+
+    // switches observations from full ARGB frames to grayscale shrunk to
+    // width x height, the last `stack` frames each
+    void setObservation(int width, int height, int stack);
+
+    // game variables to hand back every step along with the frames
+    void setRamSpec(RamSpec const &spec);
+
+    // has every game hash its sound each step (see Emulator::setAudioHash),
+    // for audioHashes to hand back
+    void setAudioHash(bool enabled);
+    void audioHashes(uint64_t *out);
+
+    // actions holds one button byte per game (see Emulator::setButtons),
+    // observations gets every game's observation, observationBytes() each,
+    // and ram (if not NULL) every game's variables, ramBytes() each
+    void step(uint8_t const *actions, uint8_t *observations, uint8_t *ram = NULL);
+    int reset(int env);
+
+    int size();
+    size_t observationBytes();
+    size_t ramBytes();
+    long framesRun();
+    double framesPerSecond();
+
+private:
+    vector<Emulator*> envs;
+    vector<FrameObserver*> observers;
+    RamSpec ram_spec;
+    ThreadPool pool;
+    bool color_on;
+
+    long frames_run = 0;
+    chrono::steady_clock::duration time_running{0};
+};
+
+#endif
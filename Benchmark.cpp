@@ -0,0 +1,185 @@
+#include "Benchmark.h"
+#include "Scaler.h"
+#include <chrono>
+#include <stdio.h>
+#include <unistd.h>
+
+int Benchmark::run(string name, string file, bool color_on) {
+    if (name == "fork")
+        return fork(file, color_on);
+    if (name == "batch")
+        return batch(file, color_on);
+    if (name == "search")
+        return search(file, color_on);
+    if (name == "scale")
+        return scale(file, color_on);
+
+    printf("Unknown benchmark %s\n", name.c_str());
+    return 1;
+}
+
+size_t Benchmark::residentBytes() {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL)
+        return 0;
+
+    unsigned long pages = 0, resident = 0;
+    if (fscanf(f, "%lu %lu", &pages, &resident) != 2)
+        resident = 0;
+    fclose(f);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Forks a batch of branches off a running game, lets each one play a frame
+// with different input, and reports how fast that is and how much memory a
+// live branch really costs.
+int Benchmark::fork(string file, bool color_on) {
+    const int warmup_frames = 300;
+    const int num_branches = 256;
+
+    Emulator *root = new Emulator(color_on);
+    if (root->start(file)) {
+        delete root;
+        return 1;
+    }
+    for (int i=0; i<warmup_frames; i++)
+        root->runFrame(false);
+
+    vector<Emulator*> branches;
+    size_t rss_before = residentBytes();
+    auto begin = chrono::steady_clock::now();
+    for (int i=0; i<num_branches; i++) {
+        Emulator *branch = root->fork();
+        if (branch == NULL)
+            break;
+        branches.push_back(branch);
+    }
+    auto forked = chrono::steady_clock::now();
+    for (size_t i=0; i<branches.size(); i++) {
+        branches[i]->setButtons(i & 0xff);
+        branches[i]->runFrame(false);
+    }
+    auto ran = chrono::steady_clock::now();
+    size_t rss_after = residentBytes();
+
+    double fork_s = chrono::duration<double>(forked - begin).count();
+    double run_s = chrono::duration<double>(ran - forked).count();
+    int n = branches.size();
+    printf("fork: %d branches, %.0f forks/s, %.0f branch frames/s\n",
+           n, n / fork_s, n / run_s);
+    printf("fork: %.1f KB per live branch (state is %zu KB)\n",
+           n ? (double)(rss_after - rss_before) / n / 1024 : 0.0, root->stateSize() / 1024);
+
+    for (Emulator *branch : branches)
+        delete branch;
+    delete root;
+    return n == num_branches ? 0 : 1;
+}
+
+// Steps the same batch of games with more and more threads, to see how
+// close to linear the scaling is, then once more with 84x84x4 grayscale
+// observations instead of full frames.
+int Benchmark::batch(string file, bool color_on) {
+    const int num_envs = 64;
+    const int num_steps = 60;
+    int cores = thread::hardware_concurrency();
+    if (cores < 1)
+        cores = 1;
+
+    double single = 0;
+    for (int threads=1; ; threads*=2) {
+        if (threads > cores)
+            threads = cores;
+
+        double fps = batchFPS(file, color_on, num_envs, num_steps, threads, false);
+        if (fps < 0)
+            return 1;
+        if (threads == 1)
+            single = fps;
+        printf("batch: %d games, %2d threads, %.0f frames/s (%.2fx)\n",
+               num_envs, threads, fps, fps / single);
+
+        if (threads == cores)
+            break;
+    }
+
+    double fps = batchFPS(file, color_on, num_envs, num_steps, cores, true);
+    printf("batch: %d games, %2d threads, 84x84x4 gray, %.0f frames/s\n", num_envs, cores, fps);
+    return 0;
+}
+
+double Benchmark::batchFPS(string file, bool color_on, int num_envs, int num_steps, int threads, bool gray) {
+    BatchRunner runner(num_envs, color_on, threads);
+    if (gray)
+        runner.setObservation(84, 84, 4);
+    if (runner.start(file))
+        return -1;
+
+    vector<uint8_t> actions(num_envs, 0);
+    vector<uint8_t> observations(num_envs * runner.observationBytes());
+    for (int i=0; i<num_steps; i++)
+        runner.step(actions.data(), observations.data());
+    return runner.framesPerSecond();
+}
+
+// A full RAM search pass (snapshot plus compare of every region) has to be
+// cheap enough to run every frame.
+int Benchmark::search(string file, bool color_on) {
+    const int passes = 2000;
+
+    Emulator *emu = new Emulator(color_on);
+    emu->setSaveFile(false);
+    if (emu->start(file)) {
+        delete emu;
+        return 1;
+    }
+    for (int i=0; i<300; i++)
+        emu->runFrame(false);
+
+    RamSearch *search = emu->createSearch();
+    size_t bytes = search->candidates();
+    auto begin = chrono::steady_clock::now();
+    for (int i=0; i<passes; i++) {
+        if (i % 64 == 0)
+            search->reset();
+        search->filter(SEARCH_UNCHANGED);
+    }
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count() / passes;
+    printf("search: %zu bytes, %.1f us per filter\n", bytes, us);
+
+    delete search;
+    delete emu;
+    return 0;
+}
+
+// How long each scaler takes on a whole frame of the game, which is the
+// worst case since normally only the rows that changed get scaled.
+int Benchmark::scale(string file, bool color_on) {
+    const int passes = 500;
+
+    Emulator *emu = new Emulator(color_on);
+    emu->setSaveFile(false);
+    if (emu->start(file)) {
+        delete emu;
+        return 1;
+    }
+    for (int i=0; i<300; i++)
+        emu->runFrame(true);
+    vector<uint32_t> frame(emu->getFramebuffer(), emu->getFramebuffer() + 160 * 144);
+
+    Scaler scaler(160, 144);
+    vector<uint32_t> out(160 * 4 * 144 * 4);
+    for (int filter=0; filter<NUM_SCALERS; filter++) {
+        scaler.setFilter(filter);
+        int factor = scaler.factor();
+        auto begin = chrono::steady_clock::now();
+        for (int i=0; i<passes; i++)
+            scaler.scale(frame.data(), 0, 144, out.data(), 160 * factor * sizeof(uint32_t));
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count() / passes;
+        printf("scale: %-8s %dx, %7.1f us per frame, %6.0f Mpixels/s out\n",
+               Scaler::name(filter), factor, us, 160 * 144 * factor * factor / us);
+    }
+
+    delete emu;
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "Emulator.h"
+#include "BatchRunner.h"
+#include <string>
+
+using namespace std;
+
+// Timing runs started with -b [name] instead of playing the game.
+class Benchmark {
+public:
+    static int run(string name, string file, bool color_on);
+
+private:
+    static int fork(string file, bool color_on);
+    static int batch(string file, bool color_on);
+    static int search(string file, bool color_on);
+    static int scale(string file, bool color_on);
+    static double batchFPS(string file, bool color_on, int num_envs, int num_steps, int threads, bool gray);
+    static size_t residentBytes();
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "BlipBuffer.h"
+#include <math.h>
+#include <string.h>
+
+int16_t BlipBuffer::kernels[BlipBuffer::PHASES][BlipBuffer::TAPS];
+
+// Blackman-windowed sinc a little under the output Nyquist rate, one per
+// sub-sample phase, each scaled to add up to exactly 1 << 15 so a step
+// always settles at the right level.
+void BlipBuffer::makeKernels() {
+    // a static local is built exactly once even when emulators are being
+    // made on several threads at the same time
+    static bool const made = [] {
+        double const cutoff = 0.45;
+        for (int p=0; p<PHASES; p++) {
+            double f = (double)p / PHASES;
+            double taps[TAPS], sum = 0;
+            for (int k=0; k<TAPS; k++) {
+                double t = k - (TAPS/2 - 1) - f;
+                double x = 2 * M_PI * cutoff * t;
+                double sinc = t == 0 ? 1 : sin(x) / x;
+                double w = 0.42 + 0.5 * cos(M_PI * t / (TAPS/2)) + 0.08 * cos(2 * M_PI * t / (TAPS/2));
+                taps[k] = sinc * w;
+                sum += taps[k];
+            }
+
+            int total = 0;
+            for (int k=0; k<TAPS; k++) {
+                kernels[p][k] = (int16_t)lround(taps[k] / sum * 32768);
+                total += kernels[p][k];
+            }
+            kernels[p][TAPS/2 - 1] += 32768 - total;
+        }
+        return true;
+    }();
+    (void)made;
+}
+
+BlipBuffer::BlipBuffer(int clock_rate, int sample_rate, int max_samples) {
+    makeKernels();
+    this->sample_rate = sample_rate;
+    this->clock_rate = clock_rate;
+    factor = ((uint64_t)sample_rate << 32) / clock_rate;
+    this->max_samples = max_samples;
+}
+
+int BlipBuffer::getSampleRate() {
+    return sample_rate;
+}
+
+// Makes ratio times as many samples per clock as the nominal rate, for
+// nudging the output to keep up with (or hold back for) the sound card.
+void BlipBuffer::setRatio(double ratio) {
+    factor = (uint64_t)(sample_rate * ratio * 4294967296.0 / clock_rate);
+}
+
+int BlipBuffer::capacity() {
+    return max_samples;
+}
+
+void BlipBuffer::advance(int dots) {
+    position += (uint64_t)dots * factor;
+}
+
+int BlipBuffer::samplesAvailable() {
+    return position >> 32;
+}
+
+int BlipBuffer::read(int16_t *out, int count, int stride) {
+    int available = samplesAvailable();
+    if (count > available)
+        count = available;
+
+    for (int i=0; i<count; i++) {
+        integrator += buffer[i];
+        int32_t level = (int32_t)(integrator >> 15);
+        // high-pass to get rid of the DC the unipolar channels put out
+        dc += (((int64_t)level << 16) - dc) >> 10;
+        int32_t sample = level - (dc >> 16);
+        if (sample > 32767) sample = 32767;
+        if (sample < -32768) sample = -32768;
+        out[i * stride] = (int16_t)sample;
+    }
+
+    // only the samples still to come and the kernel tail have anything in
+    // them
+    int remaining = available - count + TAPS;
+    memmove(buffer.data(), buffer.data() + count, remaining * sizeof(int32_t));
+    memset(buffer.data() + remaining, 0, count * sizeof(int32_t));
+    position -= (uint64_t)count << 32;
+    return count;
+}
+
+void BlipBuffer::clear() {
+    position &= 0xffffffff;
+    integrator = 0;
+    dc = 0;
+    memset(buffer.data(), 0, buffer.size() * sizeof(int32_t));
+}
@@ -0,0 +1,62 @@
+#ifndef BLIP_BUFFER_H
+#define BLIP_BUFFER_H
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+// Band-limited synthesis of a signal that only ever jumps between levels.
+// Each jump is added at its exact (sub-sample) time as a windowed sinc
+// step into a buffer of differences, and reading integrates them. That way
+// the cost is per jump, not per clock, and square waves don't alias.
+class BlipBuffer {
+public:
+    BlipBuffer(int clock_rate, int sample_rate, int max_samples);
+
+    // delta is added `dots` clocks after the current position
+    inline void addDelta(int dots, int delta) {
+        uint64_t fixed = position + (uint64_t)dots * factor;
+        int32_t *out = &buffer[fixed >> 32];
+        int16_t const *kernel = kernels[(fixed >> (32 - PHASE_BITS)) & (PHASES - 1)];
+        for (int i=0; i<TAPS; i++)
+            out[i] += delta * kernel[i];
+    }
+
+    // the buffer is only made when there's something to put in it, so
+    // emulators with sound off never pay for it
+    inline void allocate() {
+        if (buffer.empty())
+            buffer.assign(max_samples + TAPS, 0);
+    }
+
+    void advance(int dots);
+    int samplesAvailable();
+    // reads (and removes) up to count samples, every `stride`th int16
+    int read(int16_t *out, int count, int stride);
+    void clear();
+
+    int getSampleRate();
+    void setRatio(double ratio);
+    int capacity();
+
+    static int const TAPS = 16;
+
+private:
+    static int const PHASE_BITS = 5;
+    static int const PHASES = 1 << PHASE_BITS;
+    static int16_t kernels[PHASES][TAPS];
+    static void makeKernels();
+
+    int sample_rate;
+    int clock_rate;
+    uint64_t factor;
+    uint64_t position = 0;  // 32.32 fixed point samples
+    int max_samples;
+    vector<int32_t> buffer;
+
+    int64_t integrator = 0;
+    int64_t dc = 0;         // 16.16, for the high-pass
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "CPU.h"
+#include "APU.h"
 
 CPU::CPU() {
 }
@@ -9,63 +10,218 @@ CPU::~CPU() {
 
 int CPU::init(ROM *cartridge) {
     this->cartridge = cartridge;
-    ROM_bank_0 =    cartridge->getROMbank(0);
-    ROM_bank_N =    cartridge->getROMbank(1);
-    VRAM_0 =        (uint8_t*)calloc(0x2000, sizeof(uint8_t));
-    VRAM_1 =        (uint8_t*)calloc(0x2000, sizeof(uint8_t));
-    VRAM =          VRAM_0;
-    EXT_RAM =       cartridge->getRAMbank(0);
-    WRAM_0 =        (uint8_t*)calloc(0x8000, sizeof(uint8_t));
-    WRAM_N =        WRAM_0 + 0x1000;
-    ECHO_RAM =      WRAM_0;
-    OAM =           (uint8_t*)calloc(0xA0, sizeof(uint8_t));
-    IO_registers =  (uint8_t*)calloc(0x80, sizeof(uint8_t));
-    HRAM =          (uint8_t*)calloc(0x7F, sizeof(uint8_t));
-    IE =            (uint8_t*)calloc(0x1, sizeof(uint8_t));
-
-    if (VRAM_0 == NULL || WRAM_0 == NULL || OAM == NULL || 
-        IO_registers == NULL || HRAM == NULL || IE == NULL) {
-            
+
+    arena = shared_ptr<MachineState>(MachineState::create(), MachineState::destroy);
+    if (!arena) {
         cout << "Out of memory! Not enough space for CPU." << endl;
         return 1;
     }
 
-    ifstream saved_ram(cartridge->file_path + "/saves/" + cartridge->file_raw_name + ".wram", ios::in|ios::binary|ios::ate);
-    if (saved_ram.good()) {
-        int fsize = saved_ram.tellg();
-        saved_ram.seekg(ios::beg);
+    state = arena.get();
+    regs = &state->cpu;
+    mbc = &state->mbc;
+    resetBanks();
+
+    return 0;
+}
+
+// Starts this CPU as a copy of parent that shares all of VRAM, WRAM and
+// external RAM with it until one of them writes to a bank. The parent's
+// arena is frozen as the common base and both carry on in fresh arenas,
+// which only get pages for the small state and the banks they touch.
+int CPU::fork(ROM *cartridge, CPU *parent) {
+    this->cartridge = cartridge;
+    color_on = parent->color_on;
+    fixed_clock = parent->fixed_clock;
 
-        if (fsize <= 0x8000) {
-            saved_ram.read((char*)WRAM_0, fsize);
-            printf("WRAM loaded\n");
+    shared_ptr<MachineState> base = parent->arena;
+    for (int i=0; i<EXT_BANK_ID; i++) {
+        if (!parent->bank_owner[i]) {
+            parent->bank_owner[i] = base;
         }
     }
 
+    // the parent's external RAM is its save file and stays writable, so
+    // children share a snapshot of each bank instead, which is only taken
+    // again once the parent has written to it
+    for (uint32_t i=0; i<cartridge->RAM_size / 0x2000; i++) {
+        int id = EXT_BANK_ID + i;
+        if (parent->bank_owner[id]) {
+            banks[id] = parent->banks[id];
+            bank_owner[id] = parent->bank_owner[id];
+            continue;
+        }
+        shared_ptr<uint8_t> &snapshot = parent->ext_snapshot[i];
+        if (!snapshot) {
+            snapshot = shared_ptr<uint8_t>(new uint8_t[0x2000], default_delete<uint8_t[]>());
+            memcpy(snapshot.get(), parent->banks[id], 0x2000);
+        }
+        banks[id] = snapshot.get();
+        bank_owner[id] = snapshot;
+    }
+
+    if (parent->moveToNewArena() || moveToNewArena(base)) {
+        cout << "Out of memory! Not enough space for CPU." << endl;
+        return 1;
+    }
+
+    for (int i=0; i<EXT_BANK_ID; i++) {
+        banks[i] = parent->banks[i];
+        bank_owner[i] = parent->bank_owner[i];
+    }
+    mapMemory();
+
     return 0;
 }
 
-void CPU::close() {
-    std::ofstream out(cartridge->file_path + "/saves/" + cartridge->file_raw_name + ".wram", std::ofstream::binary);
+// Carries the small state over into a new arena, leaving the banks where
+// they are (shared, as far as this CPU is concerned).
+int CPU::moveToNewArena(shared_ptr<MachineState> from) {
+    if (!from)
+        from = arena;
+
+    shared_ptr<MachineState> fresh(MachineState::create(), MachineState::destroy);
+    if (!fresh)
+        return 1;
 
-    if (EXT_RAM != NULL) {
-        out.write((char*)EXT_RAM, 0x2000);
-        printf("WRAM saved\n");
+    memcpy(fresh.get(), from.get(), offsetof(MachineState, VRAM));
+    arena = fresh;
+    state = arena.get();
+    regs = &state->cpu;
+    mbc = &state->mbc;
+    mapMemory();
+    return 0;
+}
+
+// Points every bank back at this CPU's own arena and cartridge RAM, for
+// after the whole state has been written in (init, loading a state).
+void CPU::resetBanks() {
+    for (int i=0; i<2; i++)
+        banks[VRAM_BANK_ID + i] = state->VRAM[i];
+    for (int i=0; i<8; i++)
+        banks[WRAM_BANK_ID + i] = state->WRAM[i];
+    for (int i=0; i<16; i++)
+        banks[EXT_BANK_ID + i] = i < (int)(cartridge->RAM_size / 0x2000) ? cartridge->getRAMbank(i) : NULL;
+    for (int i=0; i<NUM_BANKS; i++)
+        bank_owner[i].reset();
+    for (int i=0; i<NUM_BANKS - EXT_BANK_ID; i++)
+        ext_snapshot[i].reset();
+    ext_scratch = NULL;
+
+    mapMemory();
+}
+
+// Until the next resetBanks (i.e. loading a state), external RAM writes go
+// to a copy of the bank in scratch instead of the save file, for frames
+// that are going to be thrown away. Banks are only copied when first
+// written to, the same as after a fork. NULL stops diverting.
+void CPU::divertExternalRAM(uint8_t *scratch) {
+    ext_scratch = scratch;
+    if (scratch == NULL)
+        return;
+    for (uint32_t i=0; i<cartridge->RAM_size / 0x2000; i++) {
+        if (!bank_owner[EXT_BANK_ID + i])
+            bank_owner[EXT_BANK_ID + i] = arena;
     }
+}
 
-    out.close();
+uint8_t *CPU::ownBank(int id) {
+    if (id < WRAM_BANK_ID)
+        return state->VRAM[id - VRAM_BANK_ID];
+    if (id < EXT_BANK_ID)
+        return state->WRAM[id - WRAM_BANK_ID];
+    if (ext_scratch != NULL)
+        return ext_scratch + (id - EXT_BANK_ID) * 0x2000;
+    return cartridge->getRAMbank(id - EXT_BANK_ID);
+}
+
+// First write to a shared bank, copy it into our own memory.
+void CPU::unshareBank(int id) {
+    uint8_t *own = ownBank(id);
+    memcpy(own, banks[id], id >= WRAM_BANK_ID && id < EXT_BANK_ID ? 0x1000 : 0x2000);
+    banks[id] = own;
+    bank_owner[id].reset();
+    mapMemory();
+}
 
-    free(VRAM_0);
-    free(VRAM_1);
-    free(WRAM_0);
-    free(OAM);
-    free(IO_registers);
-    free(HRAM);
-    free(IE);
+// Derives the memory bus pointers from the bank table and the bank
+// registers, whenever either of them has changed wholesale.
+void CPU::mapMemory() {
+    ROM_bank_0 =    cartridge->getROMbank(0);
+    ROM_bank_N =    cartridge->getROMbank(mbc->ROM_bank_number);
+    VRAM_0 =        banks[VRAM_BANK_ID];
+    VRAM_1 =        banks[VRAM_BANK_ID + 1];
+    VRAM =          regs->VRAM_bank ? VRAM_1 : VRAM_0;
+    WRAM_0 =        banks[WRAM_BANK_ID];
+    WRAM_N =        banks[WRAM_BANK_ID + regs->WRAM_bank];
+    OAM =           state->OAM;
+    IO_registers =  state->IO_registers;
+    HRAM =          state->HRAM;
+    IE =            &state->IE;
+    selectRAMbank(mbc->EXT_RAM_bank);
+}
+
+// Where an address lives, without going through the bus. bank picks the
+// VRAM/WRAM/external RAM/ROM bank, or -1 for the one currently mapped in.
+// The pointer stays good until a bank is switched in wholesale (fork,
+// loading a state) or, for a shared bank, until it's first written to.
+uint8_t const *CPU::view(uint16_t address, int bank) {
+    if (address >= 0xE000 && address < 0xFE00)
+        address -= 0x2000;
+
+    if (address < 0x4000) {
+        return cartridge->getROMbank(0) + address;
+    } else if (address < 0x8000) {
+        uint8_t const *rom = cartridge->getROMbank(bank < 0 ? mbc->ROM_bank_number : bank);
+        return rom == NULL ? NULL : rom + address - 0x4000;
+    } else if (address < 0xA000) {
+        if (bank < 0) bank = regs->VRAM_bank;
+        return bank < 2 ? banks[VRAM_BANK_ID + bank] + address - 0x8000 : NULL;
+    } else if (address < 0xC000) {
+        if (bank < 0) bank = mbc->EXT_RAM_bank;
+        if (bank >= (int)(cartridge->RAM_size / 0x2000))
+            return NULL;
+        return banks[EXT_BANK_ID + bank] + address - 0xA000;
+    } else if (address < 0xD000) {
+        return banks[WRAM_BANK_ID] + address - 0xC000;
+    } else if (address < 0xE000) {
+        if (bank < 0) bank = regs->WRAM_bank;
+        return bank < 8 ? banks[WRAM_BANK_ID + bank] + address - 0xD000 : NULL;
+    } else if (address < 0xFEA0) {
+        return state->OAM + address - 0xFE00;
+    } else if (address < 0xFF00) {
+        return NULL;
+    } else if (address < 0xFF80) {
+        return state->IO_registers + address - 0xFF00;
+    } else if (address < 0xFFFF) {
+        return state->HRAM + address - 0xFF80;
+    }
+    return &state->IE;
+}
+
+void CPU::selectRAMbank(int bank) {
+    mbc->EXT_RAM_bank = bank;
+    if (bank < (int)(cartridge->RAM_size / 0x2000)) {
+        EXT_RAM = banks[EXT_BANK_ID + bank];
+    } else {
+        if (cartridge->RAM_size)
+            cout << "Tried accessing non-existent RAM bank!" << endl;
+        EXT_RAM = NULL;
+    }
+}
+
+void CPU::close() {
+    for (int i=0; i<NUM_BANKS; i++)
+        bank_owner[i].reset();
+    for (int i=0; i<NUM_BANKS - EXT_BANK_ID; i++)
+        ext_snapshot[i].reset();
+    arena.reset();
+    state = NULL;
 }
 
 uint16_t CPU::read(uint16_t mem_address) {
     if (mem_address < 0x4000) {
-        if (booting) {
+        if (regs->booting) {
             if (mem_address < 0x0100 || (mem_address >= 0x0200 && mem_address < 0x08FF && color_on)) {
                 return cartridge->readBoot(mem_address);
             }
@@ -76,10 +232,10 @@ uint16_t CPU::read(uint16_t mem_address) {
     } else if (mem_address < 0xA000) {
         return *(VRAM           + mem_address - 0x8000);
     } else if (mem_address < 0xC000) {
-        if (cartridge->MBC3 && RAM_bank_number > 0x03) {
-            return clock_registers[RAM_bank_number];
+        if (cartridge->MBC3 && mbc->RAM_bank_number > 0x03) {
+            return mbc->clock_registers[mbc->RAM_bank_number];
         }
-        else if ((RAM_enable & 0xF) == 0xA && EXT_RAM != NULL) {
+        else if ((mbc->RAM_enable & 0xF) == 0xA && EXT_RAM != NULL) {
             return *(EXT_RAM    + mem_address - 0xA000);
         }
         else    // RAM is disconnected
@@ -89,7 +245,7 @@ uint16_t CPU::read(uint16_t mem_address) {
     } else if (mem_address < 0xE000) {
         return *(WRAM_N         + mem_address - 0xD000);
     } else if (mem_address < 0xFE00) {
-        return *(ECHO_RAM       + mem_address - 0xE000);
+        return read(mem_address - 0x2000);
     } else if (mem_address < 0xFEA0) {
         return *(OAM            + mem_address - 0xFE00);
     } else if (mem_address < 0xFF00) {
@@ -97,6 +253,8 @@ uint16_t CPU::read(uint16_t mem_address) {
         // be accessed
         return 0xFF;
     } else if (mem_address < 0xFF80) {
+        if (mem_address >= 0xFF10 && mem_address < 0xFF40 && apu != NULL)
+            return apu->read(mem_address);
         return *(IO_registers   + mem_address - 0xFF00);
     } else if (mem_address < 0xFFFF) {
         return *(HRAM           + mem_address - 0xFF80);
@@ -120,75 +278,88 @@ int CPU::write(uint16_t mem_address, uint8_t value) {
     if (mem_address < 0x8000) {
         if (cartridge->MBC1) {
             if (mem_address < 0x2000) {
-                RAM_enable = value;
+                mbc->RAM_enable = value;
             } else if (mem_address < 0x4000) {
                 if (value == 0) value++;
-                ROM_bank_number &= 0x60;
-                ROM_bank_number |= (value & 0x1f);
-                ROM_bank_N = cartridge->getROMbank(ROM_bank_number);
+                mbc->ROM_bank_number &= 0x60;
+                mbc->ROM_bank_number |= (value & 0x1f);
+                ROM_bank_N = cartridge->getROMbank(mbc->ROM_bank_number);
             } else if (mem_address < 0x6000) {
                 if (cartridge->RAM_size == 0x8000) {
-                    RAM_bank_number = value;
-                    EXT_RAM = cartridge->getRAMbank(RAM_bank_number);
+                    mbc->RAM_bank_number = value;
+                    selectRAMbank(mbc->RAM_bank_number);
                 }
                 else if (cartridge->ROM_size >= 0x100000) {
-                    ROM_bank_number &= 0x1f;
-                    ROM_bank_number |= ((value & 0x03) << 5);
+                    mbc->ROM_bank_number &= 0x1f;
+                    mbc->ROM_bank_number |= ((value & 0x03) << 5);
                 }
             } else {
-                ROM_RAM_mode_select = (value != 0);
+                mbc->ROM_RAM_mode_select = (value != 0);
             }
         } else if (cartridge->MBC3) {
             if (mem_address < 0x2000) {
-                RAM_enable = value;
+                mbc->RAM_enable = value;
             } else if (mem_address < 0x4000) {
                 if (value == 0) value++;
-                ROM_bank_number = (value & 0x7f);
-                ROM_bank_N = cartridge->getROMbank(ROM_bank_number);
+                mbc->ROM_bank_number = (value & 0x7f);
+                ROM_bank_N = cartridge->getROMbank(mbc->ROM_bank_number);
             } else if (mem_address < 0x6000) {
                 if (value <= 0x03) {
-                    RAM_bank_number = value;
-                    EXT_RAM = cartridge->getRAMbank(RAM_bank_number);
+                    mbc->RAM_bank_number = value;
+                    selectRAMbank(mbc->RAM_bank_number);
                 } else {
-                    RAM_bank_number = value;
+                    mbc->RAM_bank_number = value;
                 }
             } else {
-                if (latck_clock_register == 0x00 && value == 0x01) {
+                if (mbc->latck_clock_register == 0x00 && value == 0x01) {
                     latchClock();
                 }
-                latck_clock_register = value;
+                mbc->latck_clock_register = value;
             }
         } else if (cartridge->MBC5) {
             if (mem_address < 0x2000) {
-                RAM_enable = value;
+                mbc->RAM_enable = value;
             } else if (mem_address < 0x3000) {
-                ROM_bank_number &= 0xff00;
-                ROM_bank_number |= value;
-                ROM_bank_N = cartridge->getROMbank(ROM_bank_number);
+                mbc->ROM_bank_number &= 0xff00;
+                mbc->ROM_bank_number |= value;
+                ROM_bank_N = cartridge->getROMbank(mbc->ROM_bank_number);
             } else if (mem_address < 0x4000) {
-                ROM_bank_number &= 0x00ff;
-                ROM_bank_number |= (value & 0x01) << 8;
-                ROM_bank_N = cartridge->getROMbank(ROM_bank_number);
+                mbc->ROM_bank_number &= 0x00ff;
+                mbc->ROM_bank_number |= (value & 0x01) << 8;
+                ROM_bank_N = cartridge->getROMbank(mbc->ROM_bank_number);
             } else if (mem_address < 0x6000) {
-                RAM_bank_number = value;
-                EXT_RAM = cartridge->getRAMbank(RAM_bank_number);
+                mbc->RAM_bank_number = value;
+                selectRAMbank(mbc->RAM_bank_number);
             }
         }
     } else if (mem_address < 0xA000) {
+        if (bank_owner[VRAM_BANK_ID + regs->VRAM_bank])
+            unshareBank(VRAM_BANK_ID + regs->VRAM_bank);
         *(VRAM + mem_address - 0x8000) = value;
     } else if (mem_address < 0xC000) {
-        if (cartridge->MBC3 && RAM_bank_number > 0x03)
-            clock_registers[RAM_bank_number] = value;
-        if ((RAM_enable & 0xF) == 0xA && EXT_RAM != NULL)
+        if (cartridge->MBC3 && mbc->RAM_bank_number > 0x03)
+            mbc->clock_registers[mbc->RAM_bank_number] = value;
+        if ((mbc->RAM_enable & 0xF) == 0xA && EXT_RAM != NULL) {
+            if (bank_owner[EXT_BANK_ID + mbc->EXT_RAM_bank])
+                unshareBank(EXT_BANK_ID + mbc->EXT_RAM_bank);
+            if (ext_snapshot[mbc->EXT_RAM_bank])
+                ext_snapshot[mbc->EXT_RAM_bank].reset();
             *(EXT_RAM + mem_address - 0xA000) = value;
+            if (ext_scratch == NULL)
+                cartridge->markDirty(EXT_RAM);
+        }
         else
             return 1;
     } else if (mem_address < 0xD000) {
+        if (bank_owner[WRAM_BANK_ID])
+            unshareBank(WRAM_BANK_ID);
         *(WRAM_0 + mem_address - 0xC000) = value;
     } else if (mem_address < 0xE000) {
+        if (bank_owner[WRAM_BANK_ID + regs->WRAM_bank])
+            unshareBank(WRAM_BANK_ID + regs->WRAM_bank);
         *(WRAM_N + mem_address - 0xD000) = value;
     } else if (mem_address < 0xFE00) {
-        *(ECHO_RAM + mem_address - 0xE000) = value;
+        return write(mem_address - 0x2000, value);
     } else if (mem_address < 0xFEA0) {
         *(OAM + mem_address - 0xFE00) = value;
     } else if (mem_address < 0xFF00) {
@@ -196,9 +367,12 @@ int CPU::write(uint16_t mem_address, uint8_t value) {
         // be accessed
         return 1;
     } else if (mem_address < 0xFF80) {
-        if (mem_address == 0xFF00) {
+        if (mem_address >= 0xFF10 && mem_address < 0xFF40 && apu != NULL) {
+            apu->write(mem_address, value);
+        }
+        else if (mem_address == 0xFF00) {
             *IO_registers = value & 0x30;
-            readJOYP();
+            updateJOYP();
         }
         else if (mem_address == 0xFF04) { // writing to DIV resets it
             // but no it doesn't? at least it doesn't seem that way, 
@@ -210,9 +384,9 @@ int CPU::write(uint16_t mem_address, uint8_t value) {
             *(IO_registers + mem_address - 0xFF00) |= value & 0xf8;
         }
         else if (mem_address == 0xFF46) { // start DMA transfer
-            in_DMA_transfer = true;
-            DMA_source_base = (uint16_t)value << 8;
-            DMA_add = 0x00;
+            regs->in_DMA_transfer = true;
+            regs->DMA_source_base = (uint16_t)value << 8;
+            regs->DMA_add = 0x00;
             // printf("ENTERED DMA TRANSFER\n");
         }
         else if (mem_address == 0xFF4D && color_on) {
@@ -224,31 +398,31 @@ int CPU::write(uint16_t mem_address, uint8_t value) {
 
             if (value & 0x01) {
                 VRAM = VRAM_1;
-                VRAM_bank = 1;
+                regs->VRAM_bank = 1;
             } else {
                 VRAM = VRAM_0;
-                VRAM_bank = 0;
+                regs->VRAM_bank = 0;
             }
 
             *(IO_registers + mem_address - 0xFF00) = (value & 0x01) | 0xfe;
         }
         else if (mem_address == 0xFF50) {
             *(IO_registers + mem_address - 0xFF00) = value;
-            booting = false;
+            regs->booting = false;
         }
         else if (mem_address == 0xFF55 && color_on) {
             // printf("ENTERED HDMA TRANSFER\n");
-            if (in_HDMA_transfer) {
+            if (regs->in_HDMA_transfer) {
                 if (!(value & 0x80)) {
-                    in_HDMA_transfer = false;
+                    regs->in_HDMA_transfer = false;
                     *(IO_registers + mem_address - 0xFF00) |= 0x80;
                 }
             } else {
-                hblank_DMA = (value & 0x80);
+                regs->hblank_DMA = (value & 0x80);
                 *(IO_registers + mem_address - 0xFF00) = value & 0x7f;
-                data_transferred = 0;
-                ready_for_hblank_DMA = false;
-                in_HDMA_transfer = true;
+                regs->data_transferred = 0;
+                regs->ready_for_hblank_DMA = false;
+                regs->in_HDMA_transfer = true;
             }
         }
         else if (mem_address == 0xFF69 && color_on) {
@@ -256,29 +430,20 @@ int CPU::write(uint16_t mem_address, uint8_t value) {
             if (read(0xff68) & 0x80)
                 write(0xff68, (read(0xff68)+1) & 0xbf);
 
-            BG_COLOR[address] = value;
-            int color_address = address/2;
-            int R = BG_COLOR[color_address*2] & 0x1f;
-            int G = ((BG_COLOR[color_address*2] & 0xe0) >> 5) | ((BG_COLOR[color_address*2+1] & 0x03) << 3);
-            int B = (BG_COLOR[color_address*2+1] & 0x7c) >> 2;
-            true_BG_COLOR[color_address] = 0xff000000 | (R << 19) | (G << 11) | (B << 3);
+            state->BG_COLOR[address] = value;
         }
         else if (mem_address == 0xFF6B && color_on) {
             int address = read(0xff6A) & 0x3f;
             if (read(0xff6A) & 0x80)
                 write(0xff6A, (read(0xff6A)+1) & 0xbf);
 
-            OBJ_COLOR[address] = value;
-            int color_address = address/2;
-            int R = OBJ_COLOR[color_address*2] & 0x1f;
-            int G = ((OBJ_COLOR[color_address*2] & 0xe0) >> 5) | ((OBJ_COLOR[color_address*2+1] & 0x03) << 3);
-            int B = (OBJ_COLOR[color_address*2+1] & 0x7c) >> 2;
-            true_OBJ_COLOR[color_address] = 0xff000000 | (R << 19) | (G << 11) | (B << 3);
+            state->OBJ_COLOR[address] = value;
         }
         else if (mem_address == 0xFF70 && color_on) {
             int bank = value & 0x07;
             if (bank == 0) bank++;
-            WRAM_N = WRAM_0 + 0x1000 * bank;
+            regs->WRAM_bank = bank;
+            WRAM_N = banks[WRAM_BANK_ID + bank];
             // printf("SET WRAM TO BANK %d\n", bank);
 
             *(IO_registers + mem_address - 0xFF00) = value;
@@ -300,33 +465,33 @@ void CPU::overrideSTAT(uint8_t value) {
 }
 
 int CPU::getZeroFlag() {
-    return (af&0x0080) > 0 ? 1 : 0;
+    return (regs->af&0x0080) > 0 ? 1 : 0;
 }
 
 void CPU::setZeroFlag(int i) {
-    af &= 0xff70;
+    regs->af &= 0xff70;
     if (i)
-        af |= 0x80;
+        regs->af |= 0x80;
 }
 
 int CPU::getSubtractionFlag() {
-    return (af&0x0040) > 0 ? 1 : 0;
+    return (regs->af&0x0040) > 0 ? 1 : 0;
 }
 
 void CPU::setSubtractionFlag(int i) {
-    af &= 0xffb0;
+    regs->af &= 0xffb0;
     if (i)
-        af |= 0x40;
+        regs->af |= 0x40;
 }
 
 int CPU::getHalfCarryFlag() {
-    return (af&0x0020) > 0 ? 1 : 0;
+    return (regs->af&0x0020) > 0 ? 1 : 0;
 }
 
 void CPU::setHalfCarryFlag(int i) {
-    af &= 0xffd0;
+    regs->af &= 0xffd0;
     if (i)
-        af |= 0x20;
+        regs->af |= 0x20;
 }
 
 bool CPU::causesHalfAddOverflow(uint8_t a, uint8_t b) {
@@ -335,13 +500,13 @@ bool CPU::causesHalfAddOverflow(uint8_t a, uint8_t b) {
 }
 
 int CPU::getCarryFlag() {
-    return (af&0x0010) > 0 ? 1 : 0;
+    return (regs->af&0x0010) > 0 ? 1 : 0;
 }
 
 void CPU::setCarryFlag(int i) {
-    af &= 0xffe0;
+    regs->af &= 0xffe0;
     if (i)
-        af |= 0x10;
+        regs->af |= 0x10;
 }
 
 bool CPU::causesAddOverflow(uint8_t a, uint8_t b) {
@@ -355,21 +520,21 @@ bool CPU::causesAddOverflow(uint16_t a, uint16_t b) {
 uint8_t CPU::readR8(int target) {
     switch (target) {
         case 0: // b
-            return (bc & 0xff00) >> 8;
+            return (regs->bc & 0xff00) >> 8;
         case 1: // c
-            return (bc & 0x00ff) >> 0;
+            return (regs->bc & 0x00ff) >> 0;
         case 2: // d
-            return (de & 0xff00) >> 8;
+            return (regs->de & 0xff00) >> 8;
         case 3: // e
-            return (de & 0x00ff) >> 0;
+            return (regs->de & 0x00ff) >> 0;
         case 4: // h
-            return (hl & 0xff00) >> 8;
+            return (regs->hl & 0xff00) >> 8;
         case 5: // l
-            return (hl & 0x00ff) >> 0;
+            return (regs->hl & 0x00ff) >> 0;
         case 6: // [hl]
-            return read(hl);
+            return read(regs->hl);
         case 7: // a
-            return (af & 0xff00) >> 8;
+            return (regs->af & 0xff00) >> 8;
     }
 
     // something went wrong
@@ -380,28 +545,28 @@ uint8_t CPU::readR8(int target) {
 void CPU::writeR8(int target, uint16_t value) {
     switch (target) {
         case 0: // b
-            bc = (bc & 0x00ff) | (value << 8);
+            regs->bc = (regs->bc & 0x00ff) | (value << 8);
             break;
         case 1: // c
-            bc = (bc & 0xff00) | (value << 0);
+            regs->bc = (regs->bc & 0xff00) | (value << 0);
             break;
         case 2: // d
-            de = (de & 0x00ff) | (value << 8);
+            regs->de = (regs->de & 0x00ff) | (value << 8);
             break;
         case 3: // e
-            de = (de & 0xff00) | (value << 0);
+            regs->de = (regs->de & 0xff00) | (value << 0);
             break;
         case 4: // h
-            hl = (hl & 0x00ff) | (value << 8);
+            regs->hl = (regs->hl & 0x00ff) | (value << 8);
             break;
         case 5: // l
-            hl = (hl & 0xff00) | (value << 0);
+            regs->hl = (regs->hl & 0xff00) | (value << 0);
             break;
         case 6: // [hl]
-            write(hl, (uint8_t)value);
+            write(regs->hl, (uint8_t)value);
             break;
         case 7: // a
-            af = (af & 0x00ff) | (value << 8);
+            regs->af = (regs->af & 0x00ff) | (value << 8);
             break;
         default:
             printf("writeR8 invalid argument: %d", target);
@@ -440,13 +605,13 @@ void printR8(int target) {
 uint16_t CPU::readR16(int target) {
     switch (target) {
         case 0: // bc
-            return bc;
+            return regs->bc;
         case 1: // de
-            return de;
+            return regs->de;
         case 2: // hl
-            return hl;
+            return regs->hl;
         case 3: // sp
-            return sp;
+            return regs->sp;
     }
 
     // something went wrong
@@ -457,13 +622,13 @@ uint16_t CPU::readR16(int target) {
 uint16_t CPU::readR16mem(int target) {
     switch (target) {
         case 0: // bc
-            return bc;
+            return regs->bc;
         case 1: // de
-            return de;
+            return regs->de;
         case 2: // hl+
-            return hl++;
+            return regs->hl++;
         case 3: // hl-
-            return hl--;
+            return regs->hl--;
     }
 
     // something went wrong
@@ -474,16 +639,16 @@ uint16_t CPU::readR16mem(int target) {
 void CPU::writeR16(int target, uint16_t value) {
     switch (target) {
         case 0: // bc
-            bc = value;
+            regs->bc = value;
             break;
         case 1: // de
-            de = value;
+            regs->de = value;
             break;
         case 2: // hl
-            hl = value;
+            regs->hl = value;
             break;
         case 3: // sp
-            sp = value;
+            regs->sp = value;
             break;
         default:
             printf("writeR16 invalid argument: %d", target);
@@ -584,35 +749,35 @@ uint8_t CPU::getInterruptFlag() {
 }
 
 bool CPU::getInterruptMaster() {
-    return IME;
+    return regs->IME;
 }
 
 int CPU::enterInterrupt(int bit) {
-    IME = false;
+    regs->IME = false;
     write(0xff0f, read(0xff0f) & (~(1 << bit)));
     
-    write(--sp, (pc & 0xff00) >> 8);
-    write(--sp, pc & 0x00ff);
-    pc = interruptHandlers[bit];
+    write(--regs->sp, (regs->pc & 0xff00) >> 8);
+    write(--regs->sp, regs->pc & 0x00ff);
+    regs->pc = interruptHandlers[bit];
 
     return 5;
 }
 
 void CPU::eiPostExecute() {
-    if (ei_timer != 0) {
-        ei_timer--;
-        if (ei_timer == 0) {
-            IME = true;
+    if (regs->ei_timer != 0) {
+        regs->ei_timer--;
+        if (regs->ei_timer == 0) {
+            regs->IME = true;
         }
     }
 }
 
 int CPU::interruptHander() {
     if (getInterruptEnable() & getInterruptFlag()) {
-        if (halt) {
-            halt = false;
+        if (regs->halt) {
+            regs->halt = false;
         }
-        if (IME) {
+        if (regs->IME) {
             uint8_t interrupts = (getInterruptEnable() & getInterruptFlag());
             for (int bit=0; bit<5; bit++) {
                 if (interrupts & (0x1 << bit)) {
@@ -626,33 +791,13 @@ int CPU::interruptHander() {
     return 0;
 }
 
-void CPU::readJOYP() {
+// Puts the buttons held in key_map into JOYP for the selected row.
+void CPU::updateJOYP() {
     // printf("Called readJOYP, JOYP = %02X --> ", *IO_registers);
     uint8_t JOYP = *IO_registers | 0x0f;
     bool select = !(JOYP & 0x20);
     bool d_pad  = !(JOYP & 0x10);
 
-    SDL_Event e;
-    while (SDL_PollEvent(&e) != 0) {
-        if (e.type == SDL_QUIT) {
-            key_map[8] = true;
-        }
-        if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
-            switch (e.key.keysym.sym) {
-                case SDLK_ESCAPE:
-                case SDLK_RETURN: key_map[0] = e.type == SDL_KEYDOWN; break;
-                case SDLK_SPACE: key_map[1] = e.type == SDL_KEYDOWN; break;
-                case SDLK_l: key_map[2] = e.type == SDL_KEYDOWN; break;
-                case SDLK_k: key_map[3] = e.type == SDL_KEYDOWN; break;
-                case SDLK_s: key_map[4] = e.type == SDL_KEYDOWN; break;
-                case SDLK_w: key_map[5] = e.type == SDL_KEYDOWN; break;
-                case SDLK_a: key_map[6] = e.type == SDL_KEYDOWN; break;
-                case SDLK_d: key_map[7] = e.type == SDL_KEYDOWN; break;
-                case SDLK_LSHIFT: key_map[9] = e.type == SDL_KEYDOWN; break;
-            }
-        }
-    }
-
     if (select) {
         if (key_map[0])
             JOYP &= ~(0x08);
@@ -681,36 +826,39 @@ void CPU::readJOYP() {
     // printf("%02X\n", *IO_registers);
 }
 
-bool CPU::isQuit() {
-    return key_map[8];
-}
-
 void CPU::latchClock() {
-    time_t t = time(0);
-    tm* now = localtime(&t);
+    tm local;
+    tm* now;
+    if (fixed_clock >= 0) {
+        time_t t = fixed_clock + regs->dots / 4194304;
+        now = gmtime_r(&t, &local);
+    } else {
+        time_t t = time(0);
+        now = localtime_r(&t, &local);
+    }
     // doesn't account for leap years, but not really super important
     int days_since_1900 = (now->tm_yday + 365*(now->tm_year)) % 512;
     
-    clock_registers[0x08] = now->tm_sec;
-    if (clock_registers[0x08] > 59) clock_registers[0x08] -= 60;
-    clock_registers[0x09] = now->tm_min;
-    clock_registers[0x0A] = now->tm_hour;
-    clock_registers[0x0B] = days_since_1900 & 0x00ff;
-    clock_registers[0x0C] = (days_since_1900 & 0x0100) >> 8;
+    mbc->clock_registers[0x08] = now->tm_sec;
+    if (mbc->clock_registers[0x08] > 59) mbc->clock_registers[0x08] -= 60;
+    mbc->clock_registers[0x09] = now->tm_min;
+    mbc->clock_registers[0x0A] = now->tm_hour;
+    mbc->clock_registers[0x0B] = days_since_1900 & 0x00ff;
+    mbc->clock_registers[0x0C] = (days_since_1900 & 0x0100) >> 8;
 }
 
 void CPU::executeTimers(int32_t new_cycles) {
-    m_cycles_for_div -= new_cycles;
-    while (m_cycles_for_div <= 0) {
+    regs->m_cycles_for_div -= new_cycles;
+    while (regs->m_cycles_for_div <= 0) {
         write(0xff04, read(0xff04) + 1);
-        m_cycles_for_div += 64;
+        regs->m_cycles_for_div += 64;
     }
 
     uint8_t TAC = read(0xff07);
     if (TAC & 0x04) {
-        m_cycles_for_tima -= new_cycles;
-        while (m_cycles_for_tima <= 0) {
-            m_cycles_for_tima += tac_clock_select[TAC & 0x3];
+        regs->m_cycles_for_tima -= new_cycles;
+        while (regs->m_cycles_for_tima <= 0) {
+            regs->m_cycles_for_tima += tac_clock_select[TAC & 0x3];
             if (read(0xff05) == 0xff) {
                 write(0xff05, read(0xff06));
                 write(0xff0f, read(0xff0f) | 0x04);
@@ -724,10 +872,10 @@ void CPU::executeTimers(int32_t new_cycles) {
 
 void CPU::executeDMA(uint32_t new_cycles) {
     while (new_cycles-->0) {
-        write(0xfe00 + DMA_add, read(DMA_source_base + DMA_add));
-        DMA_add++;
-        if (DMA_add == 0xA0) {
-            in_DMA_transfer = false;
+        write(0xfe00 + regs->DMA_add, read(regs->DMA_source_base + regs->DMA_add));
+        regs->DMA_add++;
+        if (regs->DMA_add == 0xA0) {
+            regs->in_DMA_transfer = false;
             return;
         }
     }
@@ -735,67 +883,67 @@ void CPU::executeDMA(uint32_t new_cycles) {
 
 // not implemented: stop
 int CPU::executeOP() {
-    if (halt) return 1;
-    if (debug) printf("%04X %04X ", pc, sp);
+    if (regs->halt) return 1;
+    if (debug) printf("%04X %04X ", regs->pc, regs->sp);
 
-    if (in_HDMA_transfer) { // in HDMA
+    if (regs->in_HDMA_transfer) { // in HDMA
         uint16_t source = read(0xff52) | (read(0xff51) << 8);
         uint16_t dest = read(0xff54) | (read(0xff53) << 8);
         source &= 0xfff0; 
-        source += data_transferred;
+        source += regs->data_transferred;
         dest &= 0x1ff0;
-        dest += 0x8000 + data_transferred;
+        dest += 0x8000 + regs->data_transferred;
 
-        if (hblank_DMA) {
+        if (regs->hblank_DMA) {
             if (read(0xff41) & 0x03) { // not in hblank
-                ready_for_hblank_DMA = true;
-            } else if (ready_for_hblank_DMA) {
+                regs->ready_for_hblank_DMA = true;
+            } else if (regs->ready_for_hblank_DMA) {
                 for (uint8_t i = 0x00; i < 0x10; i++) {
                     write(dest+i, read(source+i));
                 }
-                data_transferred += 0x10;
-                ready_for_hblank_DMA = false;
+                regs->data_transferred += 0x10;
+                regs->ready_for_hblank_DMA = false;
 
                 if (read(0xff55) == 0) {
                     *(IO_registers + 0x0055) = 0xff;
-                    in_HDMA_transfer = false;
+                    regs->in_HDMA_transfer = false;
                 }
                 else {
                     *(IO_registers + 0x0055) -= 1;
                 }
 
-                return 32 / speed;
+                return 32 / regs->speed;
             }
         } else {
             for (uint8_t i = 0x00; i < 0x10; i++) {
                 write(dest+i, read(source+i));
             }
-            data_transferred += 0x10;
+            regs->data_transferred += 0x10;
 
             if (read(0xff55) == 0) {
                 *(IO_registers + 0x0055) = 0xff;
-                in_HDMA_transfer = false;
+                regs->in_HDMA_transfer = false;
             }
             else {
                 *(IO_registers + 0x0055) -= 1;
             }
 
-            return 32 / speed;
+            return 32 / regs->speed;
         }
     }
 
     uint8_t imm8;
     uint16_t imm16;
-    int r8, r8_2, r16, u3, cc, tgt3;
+    int r8, r8_2, r16, u3, cc;
     uint8_t carry;
     int8_t imm8_signed;
 
-    uint8_t op = read(pc++);
+    uint8_t op = read(regs->pc++);
     // if (debug) printf("%02X ", op);
 
-    if (halt_bug) {
-        pc--;
-        halt_bug = false;
+    if (regs->halt_bug) {
+        regs->pc--;
+        regs->halt_bug = false;
     }
 
     switch ((op & 0xc0) >> 6) { // consider bits 6 & 7
@@ -904,7 +1052,7 @@ int CPU::executeOP() {
                         if (debug) {printf("dec "); printR8(r8); printf("\n");}
                         return 1 + (r8 == 6)*2;
                     case 0x02:  // ld r8, imm8
-                        imm8 = read(pc++);
+                        imm8 = read(regs->pc++);
                         r8 = (op & 0x38) >> 3;
                         writeR8(r8, imm8);
 
@@ -913,12 +1061,12 @@ int CPU::executeOP() {
                 }
             }
         } else if ((op & 0x27) == 0x20) { // jr cond, imm8
-            imm8_signed = read(pc++);
+            imm8_signed = read(regs->pc++);
             cc = (op & 0x18) >> 3;
 
             if (debug) {printf("jr "); printCond(cc); printf(", imm8"); printf("\n");}
             if (getCallCondition(cc)) {
-                pc += imm8_signed;
+                regs->pc += imm8_signed;
                 return 3;
             }
             return 2;
@@ -932,11 +1080,11 @@ int CPU::executeOP() {
                         // enter very low power mode
                         if (read(0xff4d) & 0x01) {
                             if (read(0xff4d) & 0x80) {
-                                speed = 2;
+                                regs->speed = 2;
                                 write(0xff4d, read(0xff4d) & 0x7f);
                             }
                             else {
-                                speed = 4;
+                                regs->speed = 4;
                                 write(0xff4d, read(0xff4d) | 0x80);
                             }
 
@@ -946,7 +1094,7 @@ int CPU::executeOP() {
                         return 0;
                     }
                 case 0x01:  // ld r16, imm16
-                    imm16 = read(pc++); imm16 |= (read(pc++) << 8);
+                    imm16 = read(regs->pc++); imm16 |= (read(regs->pc++) << 8);
                     r16 = (op & 0x30) >> 4;
                     writeR16(r16, imm16);
 
@@ -966,25 +1114,25 @@ int CPU::executeOP() {
                     return 2;
                 case 0x08:
                     if (op == 0x18) {   // jr imm8
-                        imm8_signed = read(pc++);
-                        pc += imm8_signed;
+                        imm8_signed = read(regs->pc++);
+                        regs->pc += imm8_signed;
 
                         if (debug) {printf("jr imm8"); printf("\n");}
                         return 3;
                     } else {    // ld [imm16], sp
-                        imm16 = read(pc++); imm16 |= (read(pc++) << 8);
-                        write(imm16, sp & 0xff);
-                        write(imm16+1, (sp & 0xff00) >> 8);
+                        imm16 = read(regs->pc++); imm16 |= (read(regs->pc++) << 8);
+                        write(imm16, regs->sp & 0xff);
+                        write(imm16+1, (regs->sp & 0xff00) >> 8);
 
                         if (debug) {printf("ld [imm16], sp"); printf("\n");}
                         return 5;
                     }
                 case 0x09:  // add hl, r16
                     r16 = (op & 0x30) >> 4;
-                    setCarryFlag((uint16_t)(hl + readR16(r16)) < hl);
-                    setHalfCarryFlag((((hl & 0x0fff) + (readR16(r16) & 0x0fff)) & 0x1000) > 0);
+                    setCarryFlag((uint16_t)(regs->hl + readR16(r16)) < regs->hl);
+                    setHalfCarryFlag((((regs->hl & 0x0fff) + (readR16(r16) & 0x0fff)) & 0x1000) > 0);
                     setSubtractionFlag(0);
-                    writeR16(2, hl + readR16(r16));
+                    writeR16(2, regs->hl + readR16(r16));
 
                     if (debug) {printf("add hl, "); printR16(r16); printf("\n");}
                     return 2;
@@ -1006,10 +1154,10 @@ int CPU::executeOP() {
     
     case 0x01: // block 1
         if (op == 0x76) {   // halt
-            halt = true;
-            if (!IME && (getInterruptEnable() & getInterruptFlag())) {
-                halt_bug = true;
-                halt = false;
+            regs->halt = true;
+            if (!regs->IME && (getInterruptEnable() & getInterruptFlag())) {
+                regs->halt_bug = true;
+                regs->halt = false;
             }
 
             if (debug) {printf("halt"); printf("\n");}
@@ -1109,7 +1257,7 @@ int CPU::executeOP() {
     case 0x03: // block 3
         switch (op) {
             case 0xc6:  // add a, imm8
-                imm8 = read(pc++);
+                imm8 = read(regs->pc++);
                 setCarryFlag(causesAddOverflow(readR8(7), imm8));
                 setHalfCarryFlag(causesHalfAddOverflow(readR8(7), imm8));
                 setSubtractionFlag(0);
@@ -1119,7 +1267,7 @@ int CPU::executeOP() {
                 if (debug) {printf("add a, imm8"); printf("\n");}
                 return 2;
             case 0xce:  // adc a, imm8
-                imm8 = read(pc++);
+                imm8 = read(regs->pc++);
                 carry = getCarryFlag();
                 setCarryFlag(causesAddOverflow(readR8(7), imm8 + carry) |
                     causesAddOverflow(imm8, carry));
@@ -1132,7 +1280,7 @@ int CPU::executeOP() {
                 if (debug) {printf("adc a, imm8"); printf("\n");}
                 return 2;
             case 0xd6:  // sub a, imm8
-                imm8 = read(pc++);
+                imm8 = read(regs->pc++);
                 setHalfCarryFlag((imm8 & 0x0f) > (readR8(7) & 0x0f));
                 setCarryFlag(imm8 > readR8(7));
                 setSubtractionFlag(1);
@@ -1142,7 +1290,7 @@ int CPU::executeOP() {
                 if (debug) {printf("sub a, imm8"); printf("\n");}
                 return 2;
             case 0xde:  // sbc a, imm8
-                imm8 = read(pc++);
+                imm8 = read(regs->pc++);
                 carry = getCarryFlag();
                 setHalfCarryFlag((((readR8(7) & 0xf) - (imm8 & 0xf) - (carry & 0xf)) & 0x10) > 0);
                 setCarryFlag(imm8 + carry > readR8(7));
@@ -1153,7 +1301,7 @@ int CPU::executeOP() {
                 if (debug) {printf("sbc a, imm8"); printf("\n");}
                 return 2;
             case 0xe6:  // and a, imm8
-                imm8 = read(pc++);
+                imm8 = read(regs->pc++);
                 setCarryFlag(0);
                 setHalfCarryFlag(1);
                 setSubtractionFlag(0);
@@ -1163,7 +1311,7 @@ int CPU::executeOP() {
                 if (debug) {printf("and a, imm8"); printf("\n");}
                 return 2;
             case 0xee:  // xor a, imm8
-                imm8 = read(pc++);
+                imm8 = read(regs->pc++);
                 setCarryFlag(0);
                 setHalfCarryFlag(0);
                 setSubtractionFlag(0);
@@ -1173,7 +1321,7 @@ int CPU::executeOP() {
                 if (debug) {printf("xor a, imm8"); printf("\n");}
                 return 2;
             case 0xf6:  //  or a, imm8
-                imm8 = read(pc++);
+                imm8 = read(regs->pc++);
                 writeR8(7, readR8(7) | imm8);
                 setCarryFlag(0);
                 setHalfCarryFlag(0);
@@ -1183,7 +1331,7 @@ int CPU::executeOP() {
                 if (debug) {printf("or a, imm8"); printf("\n");}
                 return 2;
             case 0xfe:  //  cp a, imm8
-                imm8 = read(pc++);
+                imm8 = read(regs->pc++);
                 setZeroFlag(readR8(7) == imm8);
                 setSubtractionFlag(1);
                 setHalfCarryFlag((readR8(7) & 0x0f) < (imm8 & 0x0f));
@@ -1192,40 +1340,40 @@ int CPU::executeOP() {
                 if (debug) {printf("cp a = %02X, imm8 = %02X", readR8(7), imm8); printf("\n");}
                 return 2;
             case 0xc9:  // ret
-                r8 = read(sp++);
-                r8_2 = read(sp++);
-                pc = (r8 | (r8_2 << 8)) & 0xffff;
+                r8 = read(regs->sp++);
+                r8_2 = read(regs->sp++);
+                regs->pc = (r8 | (r8_2 << 8)) & 0xffff;
                 
                 if (debug) {printf("ret"); printf("\n");}
                 return 4;
             case 0xd9:  // reti
-                r8 = read(sp++);
-                r8_2 = read(sp++);
-                pc = r8 | (r8_2 << 8);
+                r8 = read(regs->sp++);
+                r8_2 = read(regs->sp++);
+                regs->pc = r8 | (r8_2 << 8);
 
                 // set IME
-                IME = true;
+                regs->IME = true;
 
                 if (debug) {printf("reti"); printf("\n");}
                 return 4;
             case 0xc3:  // jp imm16
-                imm16 = read(pc++); imm16 |= (read(pc++) << 8);
-                pc = imm16;
+                imm16 = read(regs->pc++); imm16 |= (read(regs->pc++) << 8);
+                regs->pc = imm16;
 
                 if (debug) {printf("jp imm16"); printf("\n");}
                 return 4;
             case 0xe9:  // jp hl
-                pc = hl;
+                regs->pc = regs->hl;
 
                 if (debug) {printf("jp hl"); printf("\n");}
                 return 1;
             case 0xcd:  // call imm16
-                imm16 = read(pc++); imm16 |= (read(pc++) << 8);
-                write(--sp, (pc & 0xff00) >> 8);
-                write(--sp, pc & 0x00ff);
-                pc = imm16;
+                imm16 = read(regs->pc++); imm16 |= (read(regs->pc++) << 8);
+                write(--regs->sp, (regs->pc & 0xff00) >> 8);
+                write(--regs->sp, regs->pc & 0x00ff);
+                regs->pc = imm16;
                 
-                r8 = read(sp+1), r8_2 = read(sp);
+                r8 = read(regs->sp+1), r8_2 = read(regs->sp);
                 if (debug) {printf("call imm16"); printf("\n");}
                 return 6;
             case 0xe2:  // ldh [c], a
@@ -1234,13 +1382,13 @@ int CPU::executeOP() {
                 if (debug) {printf("ldh [c], a"); printf("\n");}
                 return 2;
             case 0xe0:  // ldh [imm8], a
-                imm8 = read(pc++);
+                imm8 = read(regs->pc++);
                 write(0xff00 | imm8, readR8(7));
 
                 if (debug) {printf("ldh [imm8], a"); printf("\n");}
                 return 3;
             case 0xea:  // ld [imm16], a
-                imm16 = read(pc++); imm16 |= (read(pc++) << 8);
+                imm16 = read(regs->pc++); imm16 |= (read(regs->pc++) << 8);
                 write(imm16, readR8(7));
                 
                 if (debug) {printf("ld [imm16], a"); printf("\n");}
@@ -1251,56 +1399,56 @@ int CPU::executeOP() {
                 if (debug) {printf("ldh a, [c]"); printf("\n");}
                 return 2;
             case 0xf0:  // ldh a, [imm8]
-                imm8 = read(pc++);
+                imm8 = read(regs->pc++);
                 writeR8(7, read(0xff00 | imm8));
 
                 if (debug) {printf("ldh a, [imm8] = %02X", imm8); printf("\n");}
                 return 3;
             case 0xfa:  // ld a, [imm16]
-                imm16 = read(pc++); imm16 |= (read(pc++) << 8);
+                imm16 = read(regs->pc++); imm16 |= (read(regs->pc++) << 8);
                 writeR8(7, read(imm16));
 
                 if (debug) {printf("ld a, [imm16]"); printf("\n");}
                 return 4;
             case 0xe8:  // add sp, imm8
-                imm8_signed = read(pc++);
-                setCarryFlag(causesAddOverflow((uint8_t)(sp & 0xff), imm8_signed));
-                setHalfCarryFlag(causesHalfAddOverflow((uint8_t)(sp & 0xff), imm8_signed));
+                imm8_signed = read(regs->pc++);
+                setCarryFlag(causesAddOverflow((uint8_t)(regs->sp & 0xff), imm8_signed));
+                setHalfCarryFlag(causesHalfAddOverflow((uint8_t)(regs->sp & 0xff), imm8_signed));
                 setSubtractionFlag(0);
                 setZeroFlag(0);
-                sp = sp + imm8_signed;
+                regs->sp = regs->sp + imm8_signed;
 
                 if (debug) {printf("add sp, imm8"); printf("\n");}
                 return 4;
             case 0xf8:  // ld hl, sp + imm8
-                imm8_signed = read(pc++);
-                setHalfCarryFlag((((sp & 0xf) + (imm8_signed & 0xf)) & 0x10) > 0);
-                setCarryFlag((sp & 0xff) + (uint8_t)imm8_signed > 0xff);
+                imm8_signed = read(regs->pc++);
+                setHalfCarryFlag((((regs->sp & 0xf) + (imm8_signed & 0xf)) & 0x10) > 0);
+                setCarryFlag((regs->sp & 0xff) + (uint8_t)imm8_signed > 0xff);
                 setZeroFlag(0);
                 setSubtractionFlag(0);
-                hl = sp + imm8_signed;
+                regs->hl = regs->sp + imm8_signed;
 
                 if (debug) {printf("ld hl, sp + imm8"); printf("\n");}
                 return 3;
             case 0xf9:  // ld sp, hl
-                sp = hl;
+                regs->sp = regs->hl;
                 
                 if (debug) {printf("ld sp, hl"); printf("\n");}
                 return 2;
             case 0xf3:  // di
                 // clear IME flag
-                IME = false;
+                regs->IME = false;
 
                 if (debug) {printf("di"); printf("\n");}
                 return 1;
             case 0xfb:  // ei
                 // set IME flag AFTER NEXT INSTRUCTION
-                ei_timer = 2;
+                regs->ei_timer = 2;
 
                 if (debug) {printf("ei"); printf("\n");}
                 return 1;
             case 0xcb:  // prefix ($CB)
-                op = read(pc++);
+                op = read(regs->pc++);
                 // if (debug) printf("%02X ", op);
                 switch ((op & 0xc0) >> 6) {
                     case 0x00:
@@ -1412,48 +1560,48 @@ int CPU::executeOP() {
 
                     if (debug) {printf("ret "); printCond(cc); printf("\n");}
                     if (getCallCondition(cc)) {
-                        r8 = read(sp++);
-                        r8_2 = read(sp++);
-                        pc = r8 | (r8_2 << 8);
+                        r8 = read(regs->sp++);
+                        r8_2 = read(regs->sp++);
+                        regs->pc = r8 | (r8_2 << 8);
 
                         return 5;
                     }
                     return 2;
                 } else if ((op & 0x27) == 0x02) {   // jp cond, imm16
-                    imm16 = read(pc++); imm16 |= (read(pc++) << 8);
+                    imm16 = read(regs->pc++); imm16 |= (read(regs->pc++) << 8);
                     cc = (op & 0x18) >> 3;
 
                     if (debug) {printf("jp "); printCond(cc); printf(", imm16\n");}
                     if (getCallCondition(cc)) {
-                        pc = imm16;
+                        regs->pc = imm16;
                         return 4;
                     }
                     return 3;
                 } else if ((op & 0x27) == 0x04) {   // call cond, imm16
-                    imm16 = read(pc++); imm16 |= (read(pc++) << 8);
+                    imm16 = read(regs->pc++); imm16 |= (read(regs->pc++) << 8);
                     cc = (op & 0x18) >> 3;
 
                     if (debug) {printf("call "); printCond(cc); printf(", imm16\n");}
                     if (getCallCondition(cc)) {
-                        write(--sp, (pc & 0xff00) >> 8);
-                        write(--sp, pc & 0x00ff);
-                        pc = imm16;
+                        write(--regs->sp, (regs->pc & 0xff00) >> 8);
+                        write(--regs->sp, regs->pc & 0x00ff);
+                        regs->pc = imm16;
                         return 6;
                     }
                     return 3;
                 } else if ((op & 0x07) == 0x07) {   // rst tgt3
                     imm16 = (op & 0x38);
-                    write(--sp, (pc & 0xff00) >> 8);
-                    write(--sp, pc & 0x00ff);
-                    pc = imm16;
+                    write(--regs->sp, (regs->pc & 0xff00) >> 8);
+                    write(--regs->sp, regs->pc & 0x00ff);
+                    regs->pc = imm16;
                     
                     if (debug) {printf("rst %02X", imm16); printf("\n");}
                     return 4;
                 } else if ((op & 0x0f) == 0x01) {   // pop r16stk
                     r16 = (op & 0x30) >> 4;
-                    r8 = read(sp++);
-                    r8_2 = read(sp++);
-                    if (r16 == 3) af = (r8 | (r8_2 << 8)) & 0xfff0;
+                    r8 = read(regs->sp++);
+                    r8_2 = read(regs->sp++);
+                    if (r16 == 3) regs->af = (r8 | (r8_2 << 8)) & 0xfff0;
                     else writeR16(r16, r8 | (r8_2 << 8));
 
                     if (debug) {printf("pop "); printR16stk(r16); printf("\n");}
@@ -1461,12 +1609,12 @@ int CPU::executeOP() {
                 } else if ((op & 0x0f) == 0x05) {   // push r16stk
                     r16 = (op & 0x30) >> 4;
                     if (r16 == 3) {
-                        write(--sp, (af & 0xff00) >> 8);
-                        write(--sp, af & 0x00ff);
+                        write(--regs->sp, (regs->af & 0xff00) >> 8);
+                        write(--regs->sp, regs->af & 0x00ff);
                     }
                     else {
-                        write(--sp, (readR16(r16) & 0xff00) >> 8);
-                        write(--sp, readR16(r16) & 0x00ff);
+                        write(--regs->sp, (readR16(r16) & 0xff00) >> 8);
+                        write(--regs->sp, readR16(r16) & 0x00ff);
                     }
 
                     if (debug) {printf("push "); printR16stk(r16); printf("\n");}
@@ -1484,12 +1632,12 @@ int CPU::executeOP() {
 
 void CPU::startupCircumvention() {
     if (color_on) {
-        af = 0x1180;
-        bc = 0x0000;
-        de = 0xFF56;
-        hl = 0x000D;
-        pc = 0x0100;
-        sp = 0xFFFE;
+        regs->af = 0x1180;
+        regs->bc = 0x0000;
+        regs->de = 0xFF56;
+        regs->hl = 0x000D;
+        regs->pc = 0x0100;
+        regs->sp = 0xFFFE;
 
         write(0xff00, 0xcf);
         write(0xff01, 0x00);
@@ -1548,12 +1696,12 @@ void CPU::startupCircumvention() {
         write(0xffff, 0x00);
     }
     else {
-        af = 0x0100;
-        bc = 0xFF13;
-        de = 0x00C1;
-        hl = 0x8403;
-        pc = 0x0100;
-        sp = 0xFFFE;
+        regs->af = 0x0100;
+        regs->bc = 0xFF13;
+        regs->de = 0x00C1;
+        regs->hl = 0x8403;
+        regs->pc = 0x0100;
+        regs->sp = 0xFFFE;
 
         write(0xff00, 0xcf);
         write(0xff01, 0x00);
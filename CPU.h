@@ -4,10 +4,19 @@
 #include <array>
 #include <ctime>
 #include "ROM.h"
-#include "SDL.h"
+#include "MachineState.h"
 
 using namespace std;
 
+class APU;
+
+// Banks of VRAM, WRAM and external RAM, which a forked CPU shares with its
+// parent until it writes to them
+#define VRAM_BANK_ID 0
+#define WRAM_BANK_ID 2
+#define EXT_BANK_ID 10
+#define NUM_BANKS 26
+
 class CPU {
 public:
     CPU();
@@ -24,73 +33,68 @@ public:
 
     bool debug = false;
 
-    bool booting = true;
+    MachineState *state = NULL;
+    CPUState *regs = NULL;
+    MapperState *mbc = NULL;
+    void mapMemory();
+    void resetBanks();
+    int fork(ROM *cartridge, CPU *parent);
+    void divertExternalRAM(uint8_t *scratch);
+    uint8_t const *getBank(int id) { return banks[id]; }
+    uint8_t const *view(uint16_t address, int bank = -1);
+
     void startupCircumvention();
 
     void eiPostExecute();
     int interruptHander();
     void executeTimers(int32_t new_cycles);
 
-    void readJOYP();
-    bool isQuit();
-    bool key_map[10] = {};
+    void updateJOYP();
+    bool key_map[8] = {};
 
-    bool in_DMA_transfer = false;
     void executeDMA(uint32_t new_cycles);
-    bool in_HDMA_transfer = false;
-    bool hblank_DMA = false;
-    bool ready_for_hblank_DMA = true;
-    int data_transferred = 0x00;
-
-    uint16_t pc = 0x0000;
-    uint16_t sp = 0x0000;
-    uint16_t af = 0x0000;
+
     uint8_t readR8(int target);
 
     bool color_on = false;
-    int VRAM_bank = 0;
-    uint32_t true_BG_COLOR[32];
-    uint32_t true_OBJ_COLOR[32];
-    int speed = 4;
+    // When 0 or more, the MBC3 clock reads this many seconds since 1970
+    // (UTC) plus the time emulated since power on, instead of the wall
+    // clock, so runs that have to come out the same every time do.
+    int64_t fixed_clock = -1;
+    // sound registers go through here when set
+    APU *apu = NULL;
 
 private:
-    // Registers
-    uint16_t bc = 0x0000;
-    uint16_t de = 0x0000;
-    uint16_t hl = 0x0000;
-
-    // Memory Bus
-    uint8_t *ROM_bank_0;
-    uint8_t *ROM_bank_N;
+    // Memory Bus, derived from state by mapMemory
+    uint8_t const *ROM_bank_0;
+    uint8_t const *ROM_bank_N;
     uint8_t *VRAM;
     uint8_t *EXT_RAM;
     uint8_t *WRAM_0;
     uint8_t *WRAM_N;
-    uint8_t *ECHO_RAM;
     uint8_t *OAM;
     uint8_t *IO_registers;
     uint8_t *HRAM;
     uint8_t *IE;
 
     uint8_t *VRAM_0, *VRAM_1;
-    uint8_t OBJ_COLOR[64];
-    uint8_t BG_COLOR[64];
-    uint8_t clock_registers[16] = {};
-    uint8_t latck_clock_register = 0xff;
-    void latchClock();
 
-    // MBC write-only variables
-    uint8_t RAM_enable;
-    uint16_t RAM_bank_number;
-    uint16_t ROM_bank_number;
-    bool ROM_RAM_mode_select;
+    shared_ptr<MachineState> arena;
+    uint8_t *banks[NUM_BANKS] = {};
+    shared_ptr<void> bank_owner[NUM_BANKS];  // set while a bank is shared
+    // copies of our own external RAM banks handed out to forks, kept until
+    // we next write to that bank so that forking again doesn't copy it again
+    shared_ptr<uint8_t> ext_snapshot[NUM_BANKS - EXT_BANK_ID];
+    // where external RAM writes go instead of the save file, see
+    // divertExternalRAM
+    uint8_t *ext_scratch = NULL;
+    uint8_t *ownBank(int id);
+    void unshareBank(int id);
+    int moveToNewArena(shared_ptr<MachineState> from = NULL);
 
-    // Interrupt master enable flag [write only]
-    bool IME = false;
+    void latchClock();
+    void selectRAMbank(int bank);
 
-    uint8_t ei_timer = 0;
-    bool halt = false;
-    bool halt_bug = false;
     uint16_t const interruptHandlers[5] = {0x0040, 0x0048, 0x0050, 0x0058, 0x0060};
 
     bool getInterruptMaster();
@@ -98,13 +102,8 @@ private:
     uint8_t getInterruptEnable();
     int enterInterrupt(int bit);
 
-    int32_t m_cycles_for_div = 0;
-    int32_t m_cycles_for_tima = 0;
     int32_t const tac_clock_select[4] = {256, 4, 16, 64};
 
-    uint16_t DMA_source_base = 0x0000;
-    uint16_t DMA_add = 0x00;
-
     int  getZeroFlag();
     void setZeroFlag(int i);
     int  getSubtractionFlag();
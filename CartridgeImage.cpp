@@ -0,0 +1,285 @@
+#include "CartridgeImage.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+string const CartridgeImage::dmg_boot_name = "../boot_roms/dmg_boot.bin";
+string const CartridgeImage::cgb_boot_name = "../boot_roms/cgb_boot.bin";
+
+mutex CartridgeImage::cache_lock;
+map<string, weak_ptr<CartridgeImage>> CartridgeImage::cache;
+
+map<int, string> const CartridgeImage::cartridge_types{
+    {0x00, "ROM ONLY"},
+    {0x01, "MBC1"},
+    {0x02, "MBC1+RAM"},
+    {0x03, "MBC1+RAM+BATTERY"},
+    {0x05, "MBC2"},
+    {0x06, "MBC2+BATTERY"},
+    {0x08, "ROM+RAM"},
+    {0x09, "ROM+RAM+BATTERY"},
+    {0x0B, "MMM01"},
+    {0x0C, "MMM01+RAM"},
+    {0x0D, "MMM01+RAM+BATTERY"},
+    {0x0F, "MBC3+TIMER+BATTERY"},
+    {0x10, "MBC3+TIMER+RAM+BATTERY"},
+    {0x11, "MBC3"},
+    {0x12, "MBC3+RAM"},
+    {0x13, "MBC3+RAM+BATTERY"},
+    {0x19, "MBC5"},
+    {0x1A, "MBC5+RAM"},
+    {0x1B, "MBC5+RAM+BATTERY"},
+    {0x1C, "MBC5+RUMBLE"},
+    {0x1D, "MBC5+RUMBLE+RAM"},
+    {0x1E, "MBC5+RUMBLE+RAM+BATTERY"},
+    {0x20, "MBC6"},
+    {0x22, "MBC7+SENSOR+RUMBLE+RAM+BATTERY"},
+    {0xFC, "POCKET CAMERA"},
+    {0xFD, "BANDAI TAMA5"},
+    {0xFE, "HuC3"},
+    {0xFF, "HuC1+RAM+BATTERY"}
+};
+
+// Maps a whole file read-only. Pages are shared with the page cache, so
+// nothing is copied up front and every process running the same file
+// shares one physical copy.
+static uint8_t *mapFile(string name, size_t *size) {
+    int fd = open(name.c_str(), O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    *size = st.st_size;
+    return (uint8_t*)data;
+}
+
+// Copies a buffer into private anonymous memory, so images made from bytes
+// are freed the same way as mapped files.
+static uint8_t *copyToMapping(uint8_t const *data, size_t size) {
+    void *copy = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (copy == MAP_FAILED)
+        return NULL;
+
+    memcpy(copy, data, size);
+    mprotect(copy, size, PROT_READ);
+    return (uint8_t*)copy;
+}
+
+CartridgeImage::CartridgeImage() {
+}
+
+CartridgeImage::~CartridgeImage() {
+    if (ROM_data != NULL) {
+        munmap(ROM_data, ROM_file_size);
+    }
+
+    if (boot_rom != NULL) {
+        munmap(boot_rom, boot_rom_size);
+    }
+}
+
+shared_ptr<CartridgeImage> CartridgeImage::open(string file, bool color_on) {
+    string key = file + (color_on ? "#cgb" : "#dmg");
+
+    lock_guard<mutex> guard(cache_lock);
+    // entries for games nobody has open any more go, so a process that
+    // goes through lots of ROMs doesn't keep a name for every one
+    for (auto it = cache.begin(); it != cache.end(); ) {
+        if (it->second.expired())
+            it = cache.erase(it);
+        else
+            ++it;
+    }
+    auto found = cache.find(key);
+    shared_ptr<CartridgeImage> image = found == cache.end() ? NULL : found->second.lock();
+    if (image)
+        return image;
+
+    image = shared_ptr<CartridgeImage>(new CartridgeImage());
+    if (image->load(file, color_on ? cgb_boot_name : dmg_boot_name))
+        return NULL;
+
+    cache[key] = image;
+    return image;
+}
+
+// For embedding: the ROM comes from the caller rather than a file, and so
+// can the boot ROM (NULL uses the usual boot ROM file). Images made this way
+// have no file name, so they are never cached and never get a save file.
+shared_ptr<CartridgeImage> CartridgeImage::fromBytes(uint8_t const *rom, size_t rom_size,
+                                                     uint8_t const *boot, size_t boot_size, bool color_on) {
+    shared_ptr<CartridgeImage> image(new CartridgeImage());
+    if (boot == NULL) {
+        if (image->loadBoot(color_on ? cgb_boot_name : dmg_boot_name))
+            return NULL;
+    } else {
+        image->boot_rom = copyToMapping(boot, boot_size);
+        image->boot_rom_size = boot_size;
+        if (image->boot_rom == NULL)
+            return NULL;
+    }
+
+    image->ROM_data = rom_size > 0 ? copyToMapping(rom, rom_size) : NULL;
+    image->ROM_file_size = rom_size;
+    if (image->ROM_data == NULL) {
+        cout << "Out of memory! Not enough space for ROM." << endl;
+        return NULL;
+    }
+
+    if (image->parseHeader())
+        return NULL;
+    return image;
+}
+
+int CartridgeImage::loadBoot(string boot_name) {
+    boot_rom = mapFile(boot_name, &boot_rom_size);
+    if (boot_rom == NULL) {
+        cout << "Couldn't read '" << boot_name << "'!" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int CartridgeImage::load(string file, string boot_name) {
+    // map boot rom
+    if (loadBoot(boot_name))
+        return 1;
+
+    file_name = file;
+    if (file.find('/') == file.npos && file.find('\\') == file.npos) {
+        file_path = "";
+        file_raw_name = file;
+    } else {
+        file_path = file.substr(0, file.find_last_of("/\\"));
+        file_raw_name = file.substr(file.find_last_of("/\\")+1);
+    }
+
+    // map file, bank pointers point straight into the page cache
+    ROM_data = mapFile(file, &ROM_file_size);
+    if (ROM_data == NULL) {
+        cout << "Couldn't read '" << file << "'!" << endl;
+        return 1;
+    }
+    return parseHeader();
+}
+
+int CartridgeImage::parseHeader() {
+    if (ROM_file_size < 0x8000) {
+        cout << "File is too small to be a ROM." << endl;
+        return 1;
+    }
+
+    nintendo_logo =        ROM_data + 0x0104;
+    title =                ROM_data + 0x0134;
+    manu_code =            ROM_data + 0x013F;
+    CGB_flag =             ROM_data + 0x0143;
+    new_licensee_code =    ROM_data + 0x0144;
+    SGB_flag =             ROM_data + 0x0146;
+    cart_type =            ROM_data + 0x0147;
+    ROM_size_info =        ROM_data + 0x0148;
+    RAM_size_info =        ROM_data + 0x0149;
+    dest_code =            ROM_data + 0x014A;
+    old_licensee_code =    ROM_data + 0x014B;
+    mask_ROM_v =           ROM_data + 0x014C;
+    header_checksum =      ROM_data + 0x014D;
+    global_checksum =      ROM_data + 0x014E;
+
+    if (*ROM_size_info <= 0x08) {
+        ROM_size = 0x8000 * (1 << *ROM_size_info);
+        num_ROM_banks = (1 << *ROM_size_info) * 2;
+
+        // never hand out banks past the end of the mapping (SIGBUS)
+        if (num_ROM_banks > ROM_file_size / 0x4000)
+            num_ROM_banks = ROM_file_size / 0x4000;
+    }
+    else {
+        cout << "Unsupported ROM size." << endl;
+        return 1;
+    }
+
+    switch (*RAM_size_info) {
+        case 0x00: RAM_size = 0;
+        case 0x01: break;
+        case 0x02: RAM_size = 0x2000; break;
+        case 0x03: RAM_size = 0x8000; break;
+        case 0x04: RAM_size = 0x20000; break;
+        case 0x05: RAM_size = 0x10000; break;
+    }
+    num_RAM_banks = RAM_size / 0x2000;
+
+    if (*cart_type >= 0x1 && *cart_type <= 0x3)
+        MBC1 = true;
+    else if (*cart_type >= 0x0F && *cart_type <= 0x13)
+        MBC3 = true;
+    else if (*cart_type >= 0x19 && *cart_type <= 0x1E)
+        MBC5 = true;
+
+    return 0;
+}
+
+void CartridgeImage::printROMinfo() const {
+    for (uint8_t r=0; r<3; r++) { for (uint8_t i=0; i<16; i++) 
+        {
+            printf("%02X ", *(nintendo_logo+16*r+i));
+        }
+
+        printf("\n");
+    }
+
+    for (int i=0; i<16 && *(title+i) != 0x00; i++) {
+        printf("%c", *(title+i));
+    }
+    printf("\n");
+
+    printf("%c%c%c%c\n", *(manu_code), *(manu_code+1), *(manu_code+2), *(manu_code+3));
+    printf("%02X\n", *(CGB_flag));
+    printf("%c%c\n", *(new_licensee_code), *(new_licensee_code+1));
+    printf("%02X\n", *(SGB_flag));
+    printf("%02X = ", *(cart_type));
+    if (cartridge_types.count(*cart_type))
+        cout << cartridge_types.at(*cart_type);
+    cout << endl;
+    printf("%02X = %d bits of ROM, %d banks\n", *(ROM_size_info), ROM_size, num_ROM_banks);
+    printf("%02X = %d bits of RAM, %d banks\n", *(RAM_size_info), RAM_size, num_RAM_banks);
+
+    if (*dest_code == 0x00)
+        cout << "Destination: Japan" << endl;
+    else
+        cout << "Destination: Overseas only" << endl;
+
+    printf("%02X\n", *(old_licensee_code));
+    printf("%02X\n", *(mask_ROM_v));
+    printf("%02X\n", *(header_checksum));
+    printf("%02X\n", *(global_checksum));
+}
+
+// NULL for a bank the cartridge doesn't have.
+uint8_t const *CartridgeImage::getROMbank(uint32_t bank_id) const {
+    if (bank_id >= num_ROM_banks)
+        return NULL;
+
+    return (ROM_data + bank_id * 0x4000);
+}
+
+bool CartridgeImage::isCGBGame() const {
+    return *CGB_flag == 0x80 || *CGB_flag == 0xC0;
+}
+
+uint16_t CartridgeImage::getGlobalChecksum() const {
+    return (*global_checksum << 8) | *(global_checksum+1);
+}
+
+uint8_t CartridgeImage::readBoot(uint16_t mem_address) const {
+    return *(boot_rom + mem_address);
+}
@@ -0,0 +1,79 @@
+#ifndef CARTRIDGE_IMAGE_H
+#define CARTRIDGE_IMAGE_H
+
+#include <string.h>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+
+// Read-only view of a cartridge and the boot ROM it runs with. Images are
+// reference counted and cached per file, so every emulator instance in the
+// process that plays the same game shares one mapping.
+class CartridgeImage {
+public:
+    ~CartridgeImage();
+
+    static shared_ptr<CartridgeImage> open(string file, bool color_on);
+    static shared_ptr<CartridgeImage> fromBytes(uint8_t const *rom, size_t rom_size,
+                                                uint8_t const *boot, size_t boot_size, bool color_on);
+
+    string file_name;
+    string file_path;
+    string file_raw_name;
+
+    void printROMinfo() const;
+
+    uint8_t const *getROMbank(uint32_t bank_id) const;
+    uint8_t readBoot(uint16_t mem_address) const;
+
+    bool isCGBGame() const;
+    uint16_t getGlobalChecksum() const;
+
+    bool MBC1 = false;
+    bool MBC3 = false;
+    bool MBC5 = false;
+
+    uint32_t RAM_size = 0;
+    uint32_t ROM_size = 0;
+    uint32_t num_ROM_banks = 0;
+    uint32_t num_RAM_banks = 0;
+
+private:
+    CartridgeImage();
+    int load(string file, string boot_name);
+    int loadBoot(string boot_name);
+    int parseHeader();
+
+    uint8_t *ROM_data = NULL;
+    size_t ROM_file_size = 0;
+
+    uint8_t *boot_rom = NULL;
+    size_t boot_rom_size = 0;
+
+    uint8_t const *nintendo_logo = NULL;
+    uint8_t const *title = NULL;
+    uint8_t const *manu_code = NULL;
+    uint8_t const *CGB_flag = NULL;
+    uint8_t const *new_licensee_code = NULL;
+    uint8_t const *SGB_flag = NULL;
+    uint8_t const *cart_type = NULL;
+    uint8_t const *ROM_size_info = NULL;
+    uint8_t const *RAM_size_info = NULL;
+    uint8_t const *dest_code = NULL;
+    uint8_t const *old_licensee_code = NULL;
+    uint8_t const *mask_ROM_v = NULL;
+    uint8_t const *header_checksum = NULL;
+    uint8_t const *global_checksum = NULL;
+
+    static string const dmg_boot_name;
+    static string const cgb_boot_name;
+
+    static mutex cache_lock;
+    static map<string, weak_ptr<CartridgeImage>> cache;
+    static map<int, string> const cartridge_types;
+};
+
+#endif
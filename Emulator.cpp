@@ -12,6 +12,16 @@ Emulator::Emulator(bool color_on) {
 }
 
 Emulator::~Emulator() {
+    delete rewind;
+    rewind = NULL;
+    if (logger != NULL)
+        logger->close();
+    delete logger;
+    logger = NULL;
+    delete ppu;
+    ppu = NULL;
+    delete apu;
+    apu = NULL;
     delete cpu;
     cpu = NULL;
     delete cartridge;
@@ -26,16 +36,171 @@ void Emulator::setDebug() {
     debug = true;
 }
 
+void Emulator::setSaveInterval(int ms) {
+    cartridge->setSaveInterval(ms);
+}
+
+void Emulator::setSaveFile(bool enabled) {
+    cartridge->setSaveFile(enabled);
+}
+
+void Emulator::setRewindBudget(size_t megabytes) {
+    rewind_budget = megabytes;
+}
+
+void Emulator::setRunAhead(int frames) {
+    run_ahead = frames;
+}
+
+// The game's clock (MBC3 RTC) starts at seconds since 1970 and only moves
+// with emulated time, instead of following the wall clock. For anything
+// that has to play out the same every time, like movies and regression
+// runs. -1 goes back to the wall clock.
+void Emulator::setFixedClock(int64_t seconds) {
+    cpu->fixed_clock = seconds;
+}
+
 int Emulator::load(string file) {
     return cartridge->load(file);
 }
 
-int my_row = 0;
-int Emulator::run(string file) {
-    // initialize
-    init();
+int Emulator::load(shared_ptr<CartridgeImage> image) {
+    return cartridge->load(image);
+}
+
+size_t Emulator::stateSize() {
+    return SaveState::size(cpu);
+}
+
+int Emulator::saveState(uint8_t *buffer, size_t size) {
+    return SaveState::save(cpu, buffer, size);
+}
+
+int Emulator::loadState(uint8_t const *buffer, size_t size) {
+    if (SaveState::load(cpu, buffer, size))
+        return 1;
+    apu->resync();
+    return 0;
+}
+
+int Emulator::saveState(string file) {
+    return SaveState::saveFile(cpu, file);
+}
+
+int Emulator::loadState(string file) {
+    if (SaveState::loadFile(cpu, file))
+        return 1;
+    apu->resync();
+    return 0;
+}
+
+string Emulator::stateFileName(int slot) {
+    return cartridge->image->file_path + "/saves/" + cartridge->image->file_raw_name + ".state" + to_string(slot);
+}
+
+// Executes one instruction along with the DMA, timers and PPU time that go
+// with it. Returns how many dots (T-cycles at normal speed) went by.
+int Emulator::step() {
+    int &t_cycle_backlog = cpu->regs->t_cycle_backlog;
+
+    // 4 T-cycles in an M-cycle
+    t_cycle_backlog += cpu->executeOP() * cpu->regs->speed;
+    // logger->writeLog(cpu);
+    cpu->eiPostExecute();
+
+    if (cpu->regs->in_DMA_transfer)
+        cpu->executeDMA(t_cycle_backlog / cpu->regs->speed);
+    cpu->executeTimers(t_cycle_backlog / cpu->regs->speed);
+    ppu->dot(t_cycle_backlog);
+    apu->advance(t_cycle_backlog);
+
+    int dots = t_cycle_backlog;
+    cpu->regs->dots += dots;
+    if (cpu->regs->in_HDMA_transfer)
+        t_cycle_backlog = 0;
+    else
+        t_cycle_backlog = cpu->interruptHander() * cpu->regs->speed;
+    return dots;
+}
+
+// Runs the machine until the PPU has finished a frame, or until a frame's
+// worth of time has gone by with the LCD off. With render off the PPU keeps
+// its exact timing but doesn't draw any pixels.
+void Emulator::runFrame(bool render) {
+    int lcd_off_dots = 0;
+
+    ppu->render = render;
+    apu->beginFrame();
+    while (!ppu->frame_ready) {
+        int dots = step();
+        if (!(cpu->read(0xff40) & 0x80)) {
+            lcd_off_dots += dots;
+            if (lcd_off_dots >= DOTS_PER_FRAME)
+                break;
+        }
+    }
+    apu->endFrame();
+
+    ppu->frame_ready = false;
+}
+
+// Runs at least the given number of dots and returns how many actually ran,
+// since instructions can't be split.
+int Emulator::runCycles(int dots) {
+    int ran = 0;
+
+    ppu->render = true;
+    apu->beginFrame();
+    while (ran < dots)
+        ran += step();
+    apu->endFrame();
+
+    ppu->frame_ready = false;
+    return ran;
+}
+
+// One frame the way the player sees it. With run-ahead on, the picture is
+// of where the game will be run_ahead frames from now with the current
+// input held, and then the machine goes back to the real frame. With render
+// off (frame skip) the frame runs exactly the same but isn't drawn.
+void Emulator::stepFrame(bool render) {
+    runFrame(render && run_ahead == 0);
 
-    begin:
+    if (run_ahead > 0) {
+        // sized here since run-ahead can be turned on after start
+        run_ahead_state.resize(stateSize());
+        run_ahead_RAM.resize(cartridge->RAM_size);
+        // without a copy of the real frame there's no coming back
+        if (saveState(run_ahead_state.data(), run_ahead_state.size()))
+            return;
+
+        // the sound of the real frame is what gets played, and the save
+        // file only ever sees real frames
+        cpu->divertExternalRAM(run_ahead_RAM.data());
+        apu->synth = false;
+        apu->hash = false;
+        for (int i=1; i<=run_ahead; i++)
+            runFrame(render && i == run_ahead);
+        apu->synth = audio;
+        apu->hash = audio_hash;
+        if (loadState(run_ahead_state.data(), run_ahead_state.size()))
+            cout << "Error: run-ahead couldn't go back to the real frame!" << endl;
+    }
+}
+
+void Emulator::recordFrame() {
+    if (rewind != NULL)
+        rewind->push();
+}
+
+int Emulator::rewindFrame() {
+    if (rewind == NULL || rewind->pop())
+        return 1;
+    apu->resync();
+    return 0;
+}
+
+int Emulator::start(string file) {
     if (file.empty()) {
         cout << "Error: no file path specified!" << endl;
         return 1;
@@ -46,57 +211,216 @@ int Emulator::run(string file) {
         return 1;
     }
 
+    return boot();
+}
+
+int Emulator::start(shared_ptr<CartridgeImage> image) {
+    if (load(image)) {
+        cout << "Error: no ROM loaded!" << endl;
+        return 1;
+    }
+
+    return boot();
+}
+
+// Brings up a fresh machine for the loaded cartridge.
+int Emulator::boot() {
     if (cpu->init(cartridge)) {
         cout << "Error: CPU couldn't be initialized!" << endl;
         return 1;
     }
 
-    cartridge->printROMinfo();
-    PPU *ppu = new PPU();
-    ppu->color_on = this->color_on;
+    if (ppu == NULL) {
+        ppu = new PPU();
+        ppu->color_on = this->color_on;
+        ppu->gray = gray;
+        ppu->setColorProfile(color_profile);
+    }
     ppu->init(cpu);
-    SDL_RenderClear(ppu->renderer);
 
-    Logger *logger = new Logger();
-    logger->open("log.txt");
-    logger->writeLog(cpu);
+    if (apu == NULL) {
+        apu = new APU();
+        apu->synth = audio;
+        apu->hash = audio_hash;
+    }
+    apu->init(cpu);
+    cpu->apu = apu;
+
+    delete rewind;
+    rewind = NULL;
+    if (rewind_budget > 0)
+        rewind = new Rewind(cpu, rewind_budget << 20);
+
+    if (debug && logger == NULL) {
+        logger = new Logger();
+        logger->open("log.txt");
+        logger->writeLog(cpu);
+    }
 
-    // cpu->startupCircumvention();
+    return 0;
+}
 
-    SDL_Event e;
-    bool quit = false;
-    while (!quit) {
-        // 4 T-cycles in an M-cycle
-        t_cycle_backlog += cpu->executeOP() * cpu->speed;
-        // logger->writeLog(cpu);
-        cpu->eiPostExecute();
+// Power cycle. The cartridge RAM is battery backed, so it stays.
+int Emulator::reset() {
+    cpu->close();
+    return boot();
+}
 
-        if (cpu->in_DMA_transfer)
-            cpu->executeDMA(t_cycle_backlog / cpu->speed);
-        cpu->executeTimers(t_cycle_backlog / cpu->speed);
-        ppu->dot(t_cycle_backlog);
+// Makes a copy of the running machine. Memory banks are shared
+// until either side writes to them, so a fork costs little more than the
+// CPU/PPU state. The child never writes to the save file.
+Emulator *Emulator::fork() {
+    Emulator *child = new Emulator(color_on);
+    child->cartridge->setSaveFile(false);
+    if (child->load(cartridge->image) || child->cpu->fork(child->cartridge, cpu)) {
+        delete child;
+        return NULL;
+    }
+    // the parent moved to a new arena too
+    ppu->mapState();
 
-        if (cpu->in_HDMA_transfer)
-            t_cycle_backlog = 0;
-        else
-            t_cycle_backlog = cpu->interruptHander() * cpu->speed;
+    child->ppu = new PPU();
+    child->ppu->color_on = ppu->color_on;
+    child->ppu->gray = gray;
+    child->gray = gray;
+    child->color_profile = color_profile;
+    child->ppu->setColorProfile(color_profile);
+    child->ppu->init(child->cpu);
 
-        if (ppu->frame_ready) {
-            // printf("%d\n", test++);
-            ppu->renderFrame();
+    child->audio = audio;
+    child->apu = new APU(apu->getSampleRate());
+    child->apu->synth = audio;
+    child->audio_hash = audio_hash;
+    child->apu->hash = audio_hash;
+    child->apu->init(child->cpu);
+    child->apu->resync();
+    child->cpu->apu = child->apu;
+    return child;
+}
 
-            if (!cpu->key_map[9])
-                this_thread::sleep_for(std::chrono::microseconds((int)(1000000 / FRAMES_PER_SEC)));
+// Bit i holds key_map[i]: start, select, B, A, down, up, left, right.
+void Emulator::setButtons(uint8_t buttons) {
+    for (int i=0; i<8; i++)
+        cpu->key_map[i] = (buttons >> i) & 1;
+    cpu->updateJOYP();
+}
 
-            cpu->readJOYP();
-            quit = cpu->isQuit();
-        }
+uint32_t const *Emulator::getFramebuffer() {
+    return ppu->getFramebuffer();
+}
+
+// The picture before colors are applied, see PPU::index_frame.
+uint8_t const *Emulator::getIndexFrame() {
+    return ppu->index_frame;
+}
+
+// Hashes of what's on screen and of the whole machine (the same bytes a
+// save state has), for checking that a change to the emulator didn't
+// change what a game does.
+uint64_t Emulator::frameHash() {
+    return Hash::xxh64(getFramebuffer(), 160 * 144 * sizeof(uint32_t));
+}
+
+uint64_t Emulator::stateHash() {
+    hash_state.resize(stateSize());
+    saveState(hash_state.data(), hash_state.size());
+    return Hash::xxh64(hash_state.data(), hash_state.size());
+}
+
+// One of the DMG color schemes (there are 11). Takes effect on the current
+// picture right away.
+void Emulator::setPalette(int palette) {
+    ppu->setPalette(palette);
+}
+
+// Which of the framebuffer's 144 lines changed since the last call, and
+// how many did.
+int Emulator::takeDirtyLines(bool *lines) {
+    int count = 0;
+    for (int y=0; y<144; y++) {
+        lines[y] = ppu->dirty[y];
+        count += lines[y];
     }
+    memset(ppu->dirty, 0, sizeof(ppu->dirty));
+    return count;
+}
 
-    delete ppu;
-    ppu = NULL;
-    delete logger;
-    logger = NULL;
+// COLOR_RAW, COLOR_GBC_LCD or COLOR_GAMMA. Only matters in color mode.
+void Emulator::setColorProfile(int profile) {
+    color_profile = profile;
+    if (ppu != NULL)
+        ppu->setColorProfile(profile);
+}
+
+// Has the PPU put out luma instead of ARGB, for getGrayFrame.
+void Emulator::setGrayscale(bool enabled) {
+    gray = enabled;
+    if (ppu != NULL)
+        ppu->gray = enabled;
+}
+
+uint8_t const *Emulator::getGrayFrame() {
+    return ppu->gray_frame;
+}
+
+// With audio off the sound hardware still runs, since games can read it,
+// but no samples are made.
+void Emulator::setAudio(bool enabled) {
+    audio = enabled;
+    if (apu != NULL)
+        apu->synth = enabled;
+}
+
+// Interleaved stereo samples made during the last runFrame/runCycles.
+int16_t const *Emulator::getAudio(size_t *frames) {
+    return apu->getSamples(frames);
+}
+
+int Emulator::getSampleRate() {
+    return apu->getSampleRate();
+}
+
+// A hash of what the sound hardware did during the last frame, for telling
+// whether two runs sound the same. It doesn't need audio on, and costs
+// less than making samples.
+void Emulator::setAudioHash(bool enabled) {
+    audio_hash = enabled;
+    if (apu != NULL)
+        apu->hash = enabled;
+}
+
+uint64_t Emulator::getAudioHash() {
+    return apu->getHash();
+}
+
+// Slightly more (ratio > 1) or fewer samples per frame than the sample
+// rate calls for, so a frontend can keep its audio queue from draining or
+// piling up when the display and sound card clocks disagree.
+void Emulator::setAudioRatio(double ratio) {
+    apu->setRatio(ratio);
+}
+
+uint8_t Emulator::readMemory(uint16_t address) {
+    return cpu->read(address);
+}
+
+void Emulator::writeMemory(uint16_t address, uint8_t value) {
+    cpu->write(address, value);
+}
+
+void Emulator::gather(RamSpec const &spec, uint8_t *out) {
+    spec.gather(cpu, out);
+}
+
+uint8_t const *Emulator::view(uint16_t address, int bank) {
+    return cpu->view(address, bank);
+}
+
+RamSearch *Emulator::createSearch() {
+    return new RamSearch(cpu);
+}
+
+void Emulator::printROMinfo() {
+    cartridge->printROMinfo();
+}
 
-    return 0;
-}
\ No newline at end of file
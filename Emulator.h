@@ -4,33 +4,107 @@
 #include "ROM.h"
 #include "CPU.h"
 #include "PPU.h"
-#include "SDL.h"
+#include "APU.h"
 #include "Logger.h"
+#include "SaveState.h"
+#include "Rewind.h"
+#include "RamSpec.h"
+#include "RamSearch.h"
+#include "Hash.h"
 #include <string.h>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 using namespace std;
 
+// 2000-01-01 00:00 UTC, where the game's clock starts in runs that have to
+// come out the same every time (see setFixedClock)
+#define FIXED_CLOCK_START 946684800
+
+// One Game Boy. Nothing in here touches a window, the keyboard or the
+// clock; the caller decides when frames run and what to do with them.
 class Emulator {
 public:
     Emulator(bool color_on);
     ~Emulator();
     int load(string file);
-    int run(string file);
+    int load(shared_ptr<CartridgeImage> image);
+    int start(string file);
+    int start(shared_ptr<CartridgeImage> image);
+    int reset();
+    Emulator *fork();
     void setDebug();
+    void setSaveInterval(int ms);
+    void setSaveFile(bool enabled);
+    void setRewindBudget(size_t megabytes);
+    void setRunAhead(int frames);
+    void setFixedClock(int64_t seconds);
+
+    void runFrame(bool render);
+    int runCycles(int dots);
+    void stepFrame(bool render = true);
+    void recordFrame();
+    int rewindFrame();
+
+    void setButtons(uint8_t buttons);
+    uint32_t const *getFramebuffer();
+    uint8_t const *getIndexFrame();
+    uint64_t frameHash();
+    uint64_t stateHash();
+    void setPalette(int palette);
+    void setColorProfile(int profile);
+    int takeDirtyLines(bool *lines);
+    void setGrayscale(bool enabled);
+    uint8_t const *getGrayFrame();
+    void setAudio(bool enabled);
+    int16_t const *getAudio(size_t *frames);
+    int getSampleRate();
+    void setAudioRatio(double ratio);
+    void setAudioHash(bool enabled);
+    uint64_t getAudioHash();
+    uint8_t readMemory(uint16_t address);
+    void writeMemory(uint16_t address, uint8_t value);
+    void gather(RamSpec const &spec, uint8_t *out);
+    uint8_t const *view(uint16_t address, int bank = -1);
+    RamSearch *createSearch();
+
+    size_t stateSize();
+    int saveState(uint8_t *buffer, size_t size);
+    int loadState(uint8_t const *buffer, size_t size);
+    int saveState(string file);
+    int loadState(string file);
+    string stateFileName(int slot);
+
+    void printROMinfo();
 private:
     ROM* cartridge;
     CPU* cpu;
+    PPU* ppu = NULL;
+    APU* apu = NULL;
+    Logger* logger = NULL;
+    Rewind* rewind = NULL;
+    size_t rewind_budget = 0;
+
+    int run_ahead = 0;
+    vector<uint8_t> run_ahead_state;
+    vector<uint8_t> run_ahead_RAM;
+    vector<uint8_t> hash_state;
+
+    int boot();
+    int step();
 
     void init();
     bool isRunning = false;
     bool isLoaded;
     bool debug = false;
     bool color_on = false;
-    int t_cycle_backlog = 0;
+    bool gray = false;
+    int color_profile = COLOR_RAW;
+    bool audio = true;
+    bool audio_hash = false;
 
     int test = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
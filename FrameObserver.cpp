@@ -0,0 +1,159 @@
+#include "FrameObserver.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+FrameObserver::FrameObserver(int width, int height, int stack) {
+    this->width = width;
+    this->height = height;
+    this->stack = stack < 1 ? 1 : stack;
+
+    rows = makeTaps(144, height);
+    columns = makeTaps(160, width);
+    row_buffer.resize(160);
+    history.resize(size());
+}
+
+size_t FrameObserver::size() {
+    return (size_t)width * height * stack;
+}
+
+void FrameObserver::reset() {
+    newest = -1;
+}
+
+// Output pixel i covers source pixels [i*from/to, (i+1)*from/to), and each
+// source pixel counts for how much of it is covered. Weights are rounded to
+// 1/256 with whatever is left over going to the biggest one, so they always
+// add up to exactly 256.
+FrameObserver::Taps FrameObserver::makeTaps(int from, int to) {
+    Taps t;
+    t.taps = (from + to - 1) / to + 1;
+    t.first.resize(to);
+    t.weights.assign(to * t.taps, 0);
+
+    for (int i=0; i<to; i++) {
+        // in units of 1/to of a source pixel
+        long begin = (long)i * from, end = (long)(i+1) * from;
+        int first = begin / to;
+        if (first + t.taps > from)
+            first = from - t.taps;
+        if (first < 0)
+            first = 0;
+        t.first[i] = first;
+
+        int total = 0, biggest = 0;
+        for (int k=0; k<t.taps && first+k<from; k++) {
+            long lo = max(begin, (long)(first+k) * to);
+            long hi = min(end, (long)(first+k+1) * to);
+            int w = hi > lo ? (int)((hi - lo) * 256 / from) : 0;
+            t.weights[i * t.taps + k] = w;
+            total += w;
+            if (w > t.weights[i * t.taps + biggest])
+                biggest = k;
+        }
+        t.weights[i * t.taps + biggest] += 256 - total;
+    }
+    return t;
+}
+
+// Luma with weights out of 128 (0.30, 0.59, 0.11).
+void FrameObserver::grayLine(uint32_t const *argb, uint8_t *gray, int n) {
+    int i = 0;
+#ifdef __SSE2__
+    // bytes are b, g, r, a; madd gives b*15 + g*75 and r*38 per pixel,
+    // the second madd adds those two up
+    __m128i const weights = _mm_setr_epi16(15, 75, 38, 0, 15, 75, 38, 0);
+    __m128i const ones = _mm_set1_epi16(1);
+    __m128i const half = _mm_set1_epi32(64);
+    __m128i const zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((__m128i const*)(argb + i));
+        __m128i b = _mm_loadu_si128((__m128i const*)(argb + i + 4));
+        __m128i a01 = _mm_madd_epi16(_mm_unpacklo_epi8(a, zero), weights);
+        __m128i a23 = _mm_madd_epi16(_mm_unpackhi_epi8(a, zero), weights);
+        __m128i b01 = _mm_madd_epi16(_mm_unpacklo_epi8(b, zero), weights);
+        __m128i b23 = _mm_madd_epi16(_mm_unpackhi_epi8(b, zero), weights);
+        __m128i ya = _mm_madd_epi16(_mm_packs_epi32(a01, a23), ones);
+        __m128i yb = _mm_madd_epi16(_mm_packs_epi32(b01, b23), ones);
+        ya = _mm_srli_epi32(_mm_add_epi32(ya, half), 7);
+        yb = _mm_srli_epi32(_mm_add_epi32(yb, half), 7);
+        __m128i y = _mm_packs_epi32(ya, yb);
+        _mm_storel_epi64((__m128i*)(gray + i), _mm_packus_epi16(y, y));
+    }
+#endif
+    for (; i < n; i++) {
+        uint32_t p = argb[i];
+        gray[i] = (((p >> 16) & 0xff) * 38 + ((p >> 8) & 0xff) * 75 + (p & 0xff) * 15 + 64) >> 7;
+    }
+}
+
+// Rows first, 16 columns at a time, then the columns of the one row.
+void FrameObserver::downscale(uint8_t const *gray_frame, uint8_t *out) {
+    uint8_t *row = row_buffer.data();
+
+    for (int y=0; y<height; y++) {
+        uint8_t const *src = gray_frame + rows.first[y] * 160;
+        uint16_t const *w = &rows.weights[y * rows.taps];
+        int x = 0;
+#ifdef __SSE2__
+        __m128i const zero = _mm_setzero_si128();
+        __m128i const half = _mm_set1_epi16(128);
+        for (; x + 16 <= 160; x += 16) {
+            __m128i lo = half, hi = half;
+            for (int k=0; k<rows.taps; k++) {
+                if (w[k] == 0)
+                    continue;
+                __m128i weight = _mm_set1_epi16(w[k]);
+                __m128i p = _mm_loadu_si128((__m128i const*)(src + k * 160 + x));
+                lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), weight));
+                hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), weight));
+            }
+            lo = _mm_srli_epi16(lo, 8);
+            hi = _mm_srli_epi16(hi, 8);
+            _mm_storeu_si128((__m128i*)(row + x), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; x < 160; x++) {
+            unsigned sum = 128;
+            for (int k=0; k<rows.taps; k++)
+                sum += src[k * 160 + x] * w[k];
+            row[x] = sum >> 8;
+        }
+
+        uint8_t *dst = out + y * width;
+        for (int i=0; i<width; i++) {
+            uint8_t const *p = row + columns.first[i];
+            uint16_t const *cw = &columns.weights[i * columns.taps];
+            unsigned sum = 128;
+            for (int k=0; k<columns.taps; k++)
+                sum += p[k] * cw[k];
+            dst[i] = sum >> 8;
+        }
+    }
+}
+
+void FrameObserver::observe(uint8_t const *gray_frame, uint8_t *out) {
+    size_t frame_size = (size_t)width * height;
+    if (stack == 1) {
+        downscale(gray_frame, out);
+        return;
+    }
+
+    // after a reset the stack starts out full of the first frame
+    if (newest < 0) {
+        downscale(gray_frame, history.data());
+        for (int i=1; i<stack; i++)
+            memcpy(&history[i * frame_size], history.data(), frame_size);
+        newest = 0;
+    } else {
+        newest = (newest + 1) % stack;
+        downscale(gray_frame, &history[newest * frame_size]);
+    }
+
+    for (int i=0; i<stack; i++) {
+        int slot = (newest + 1 + i) % stack;
+        memcpy(out + i * frame_size, &history[slot * frame_size], frame_size);
+    }
+}
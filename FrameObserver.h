@@ -0,0 +1,46 @@
+#ifndef FRAME_OBSERVER_H
+#define FRAME_OBSERVER_H
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+// What an agent sees of a game: the PPU's grayscale frame shrunk to
+// width x height by area averaging, with the last `stack` frames one after
+// another (oldest first). The kernels are SSE2 with a plain C++ fallback.
+class FrameObserver {
+public:
+    FrameObserver(int width, int height, int stack = 1);
+
+    // out gets size() bytes
+    void observe(uint8_t const *gray_frame, uint8_t *out);
+    void reset();
+    size_t size();
+
+    static void grayLine(uint32_t const *argb, uint8_t *gray, int n);
+
+private:
+    int width;
+    int height;
+    int stack;
+
+    // each output pixel is the weighted sum of `taps` source pixels from
+    // first[i] on, weights out of 256
+    struct Taps {
+        vector<int> first;
+        vector<uint16_t> weights;
+        int taps;
+    };
+    Taps rows;
+    Taps columns;
+    vector<uint8_t> row_buffer;
+
+    vector<uint8_t> history;
+    int newest = -1;
+
+    static Taps makeTaps(int from, int to);
+    void downscale(uint8_t const *gray_frame, uint8_t *out);
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "FramePacer.h"
+#include <thread>
+#include <math.h>
+
+// how long before the deadline to stop sleeping and start spinning
+#define SPIN_MICROSECONDS 1500
+
+FramePacer::FramePacer(double fps) {
+    this->fps = fps;
+    setSpeed(1.0);
+    deadline = last = clock::now();
+}
+
+void FramePacer::setSpeed(double speed) {
+    this->speed = speed;
+    if (speed > 0)
+        period = chrono::duration_cast<clock::duration>(chrono::duration<double>(1.0 / (fps * speed)));
+}
+
+double FramePacer::getSpeed() {
+    return speed;
+}
+
+void FramePacer::wait() {
+    if (speed <= 0) {
+        skip();
+        return;
+    }
+
+    deadline += period;
+    clock::time_point now = clock::now();
+    was_late = now > deadline;
+    if (was_late) {
+        late++;
+        // more than a couple of frames behind (a hiccup, or the host is
+        // too slow): start over from now rather than rushing to catch up
+        if (now - deadline > 2 * period)
+            deadline = now;
+        record(now);
+        return;
+    }
+
+    chrono::microseconds spin(SPIN_MICROSECONDS);
+    if (deadline - now > spin)
+        this_thread::sleep_until(deadline - spin);
+    while (clock::now() < deadline)
+        this_thread::yield();
+    record(clock::now());
+}
+
+void FramePacer::skip() {
+    clock::time_point now = clock::now();
+    was_late = false;
+    deadline = now;
+    record(now);
+}
+
+bool FramePacer::behind() {
+    return was_late;
+}
+
+void FramePacer::record(clock::time_point now) {
+    double ms = chrono::duration<double, milli>(now - last).count();
+    last = now;
+    frames++;
+    sum += ms;
+    sum_squares += ms * ms;
+    if (ms > worst)
+        worst = ms;
+}
+
+FramePacer::Stats FramePacer::stats() {
+    Stats s;
+    s.frames = frames;
+    s.mean_ms = frames ? sum / frames : 0;
+    s.jitter_ms = frames ? sqrt(fmax(0, sum_squares / frames - s.mean_ms * s.mean_ms)) : 0;
+    s.worst_ms = worst;
+    s.late = late;
+
+    frames = late = 0;
+    sum = sum_squares = worst = 0;
+    return s;
+}
@@ -0,0 +1,56 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+
+using namespace std;
+
+// Keeps frames coming at a steady rate. Each frame has an absolute
+// deadline one period after the last one, so time spent emulating doesn't
+// add to the wait and small oversleeps don't pile up. It sleeps until just
+// before the deadline and spins the rest of the way, since sleeps only
+// wake up to a millisecond or so late.
+class FramePacer {
+public:
+    struct Stats {
+        long frames;
+        double mean_ms;     // time between frames
+        double jitter_ms;   // standard deviation of that
+        double worst_ms;
+        long late;          // frames that missed their deadline
+    };
+
+    FramePacer(double fps);
+
+    // 1 is real time, 0 runs as fast as possible
+    void setSpeed(double speed);
+    double getSpeed();
+
+    // waits until the next frame is due
+    void wait();
+    // for when something else already waited (vsync, fast forward)
+    void skip();
+    // the numbers since the last call
+    Stats stats();
+    // whether the last frame missed its deadline
+    bool behind();
+
+private:
+    typedef chrono::steady_clock clock;
+    double fps;
+    double speed = 1.0;
+    clock::duration period;
+    clock::time_point deadline;
+    clock::time_point last;
+
+    long frames = 0;
+    long late = 0;
+    bool was_late = false;
+    double sum = 0;
+    double sum_squares = 0;
+    double worst = 0;
+
+    void record(clock::time_point now);
+};
+
+#endif
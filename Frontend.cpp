@@ -0,0 +1,406 @@
+#include "Frontend.h"
+#include <stdio.h>
+
+Frontend::Frontend(Emulator *emu) : frames(160, 144), pacer(FRAMES_PER_SEC) {
+    this->emu = emu;
+}
+
+Frontend::~Frontend() {
+    close();
+    delete search;
+}
+
+void Frontend::setAudioLatency(int ms) {
+    audio_latency = ms;
+}
+
+void Frontend::setSpeed(double speed) {
+    if (speed != 0 && speed < 0.25)
+        speed = 0.25;
+    if (speed > 16)
+        speed = 16;
+    pacer.setSpeed(speed);
+}
+
+void Frontend::setVsync(bool enabled) {
+    vsync = enabled;
+}
+
+void Frontend::setFrameSkip(int skip) {
+    frame_skip = skip;
+}
+
+void Frontend::setScaler(int filter) {
+    scaler.setFilter(filter);
+}
+
+void Frontend::setVideoFile(string file) {
+    video_file = file;
+}
+
+void Frontend::setMovieFile(string file) {
+    movie_file = file;
+    recording = !file.empty();
+    // playing it back starts from a blank cartridge RAM and the same
+    // clock, so recording has to as well
+    if (recording) {
+        emu->setSaveFile(false);
+        emu->setFixedClock(FIXED_CLOCK_START);
+    }
+}
+
+// A movie only plays back right if it covers every frame from power on,
+// so going back in time ends it.
+void Frontend::stopRecording(char const *why) {
+    if (!recording)
+        return;
+    recording = false;
+    if (movie.save(movie_file) == 0)
+        printf("Stopped recording %s after %zu frames (%s)\n", movie_file.c_str(), movie.length(), why);
+}
+
+void Frontend::setColorProfile(int profile) {
+    if (profile < 0 || profile >= NUM_COLOR_PROFILES)
+        profile = COLOR_RAW;
+    color_profile = profile;
+    emu->setColorProfile(profile);
+}
+
+int Frontend::init() {
+    if (SDL_Init(SDL_INIT_VIDEO) != 0){
+        std::cout << "SDL_Init Error: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+    // 4x, unless the scaler makes it 3x
+    int scale = scaler.factor() == 3 ? 3 : 4;
+    window = SDL_CreateWindow("C8emu", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 160 * scale, 144 * scale, SDL_WINDOW_SHOWN);
+    if (window == NULL){
+        std::cout << "SDL_CreateWindow Error: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | (vsync ? SDL_RENDERER_PRESENTVSYNC : 0));
+    if (renderer == NULL) {
+        printf( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
+        return 1;
+    } else {
+        SDL_SetRenderDrawColor( renderer, 0x00, 0x00, 0x00, 0xFF );
+    }
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                160 * scaler.factor(), 144 * scaler.factor());
+    if (texture == NULL){
+        std::cout << "SDL_CreateTexture Error: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+
+    // the game still runs without sound if there's no audio device
+    if (audio_latency > 0) {
+        audio = new AudioOutput(emu->getSampleRate(), audio_latency);
+        if (audio->open()) {
+            delete audio;
+            audio = NULL;
+        }
+    }
+    emu->setAudio(audio != NULL);
+
+    if (!video_file.empty() && video.open(video_file))
+        return 1;
+    return 0;
+}
+
+void Frontend::close() {
+    delete audio;
+    audio = NULL;
+    video.close();
+
+    if (window == NULL)
+        return;
+
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    texture = NULL;
+    renderer = NULL;
+    window = NULL;
+
+    SDL_Quit();
+}
+
+void Frontend::present(bool upload) {
+    // each run of changed rows is scaled straight into the texture, along
+    // with the rows next to them that the scaler looks at
+    uint32_t const *pixels = frames.front();
+    int factor = scaler.factor(), reach = scaler.reach();
+    bool redo[144];
+    for (int y=0; upload && y<144; y++) {
+        redo[y] = !uploaded;
+        for (int k=y-reach; k<=y+reach && !redo[y]; k++)
+            redo[y] = k >= 0 && k < 144 && frames.changed(k);
+    }
+
+    int y = 0;
+    while (upload && y < 144) {
+        if (!redo[y]) {
+            y++;
+            continue;
+        }
+        int first = y;
+        while (y < 144 && redo[y])
+            y++;
+
+        SDL_Rect rect = {0, first * factor, 160 * factor, (y - first) * factor};
+        void *out;
+        int pitch;
+        if (SDL_LockTexture(texture, &rect, &out, &pitch) == 0) {
+            scaler.scale(pixels, first, y, (uint32_t *)out, pitch);
+            SDL_UnlockTexture(texture);
+        }
+    }
+    if (upload)
+        uploaded = true;
+
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    SDL_RenderPresent(renderer);
+}
+
+void Frontend::pollInput() {
+    SDL_Event e;
+    while (SDL_PollEvent(&e) != 0) {
+        if (e.type == SDL_QUIT) {
+            key_map[8] = true;
+        }
+        if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_EXPOSED) {
+            redraw = true;
+        }
+        if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
+            switch (e.key.keysym.sym) {
+                case SDLK_ESCAPE:
+                case SDLK_RETURN: key_map[0] = e.type == SDL_KEYDOWN; break;
+                case SDLK_SPACE: key_map[1] = e.type == SDL_KEYDOWN; break;
+                case SDLK_l: key_map[2] = e.type == SDL_KEYDOWN; break;
+                case SDLK_k: key_map[3] = e.type == SDL_KEYDOWN; break;
+                case SDLK_s: key_map[4] = e.type == SDL_KEYDOWN; break;
+                case SDLK_w: key_map[5] = e.type == SDL_KEYDOWN; break;
+                case SDLK_a: key_map[6] = e.type == SDL_KEYDOWN; break;
+                case SDLK_d: key_map[7] = e.type == SDL_KEYDOWN; break;
+                case SDLK_LSHIFT: key_map[9] = e.type == SDL_KEYDOWN; break;
+                case SDLK_BACKSPACE: key_map[12] = e.type == SDL_KEYDOWN; break;
+                case SDLK_F5: if (e.type == SDL_KEYDOWN) key_map[10] = true; break;
+                case SDLK_F8: if (e.type == SDL_KEYDOWN) key_map[11] = true; break;
+                case SDLK_F1: if (e.type == SDL_KEYDOWN) search_op = -2; break;
+                case SDLK_F2: if (e.type == SDL_KEYDOWN) search_op = SEARCH_CHANGED; break;
+                case SDLK_F3: if (e.type == SDL_KEYDOWN) search_op = SEARCH_UNCHANGED; break;
+                case SDLK_F4: if (e.type == SDL_KEYDOWN) search_op = SEARCH_INCREASED; break;
+                case SDLK_F6: if (e.type == SDL_KEYDOWN) search_op = SEARCH_DECREASED; break;
+                case SDLK_F7: if (e.type == SDL_KEYDOWN) print_stats = true; break;
+                case SDLK_F9: if (e.type == SDL_KEYDOWN) palette_change = true; break;
+                case SDLK_F10: if (e.type == SDL_KEYDOWN) profile_change = true; break;
+                case SDLK_MINUS: if (e.type == SDL_KEYDOWN) speed_change = -1; break;
+                case SDLK_EQUALS: if (e.type == SDL_KEYDOWN) speed_change = 1; break;
+            }
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym >= SDLK_0 && e.key.keysym.sym <= SDLK_9)
+                state_slot = e.key.keysym.sym - SDLK_0;
+        }
+    }
+
+}
+
+uint8_t Frontend::updateButtons() {
+    uint8_t buttons = 0;
+    for (int i=0; i<8; i++)
+        buttons |= key_map[i] << i;
+    emu->setButtons(buttons);
+    return buttons;
+}
+
+void Frontend::handleHotkeys() {
+    int slot = state_slot;
+    if (key_map[10].exchange(false)) {
+        if (emu->saveState(emu->stateFileName(slot)) == 0)
+            printf("Saved state %d\n", slot);
+    }
+
+    if (key_map[11].exchange(false)) {
+        if (emu->loadState(emu->stateFileName(slot)) == 0) {
+            printf("Loaded state %d\n", slot);
+            stopRecording("loaded a state");
+        }
+    }
+}
+
+void Frontend::runSearch() {
+    int op = search_op.exchange(-1);
+    if (op == -1)
+        return;
+
+    if (search == NULL || op == -2) {
+        delete search;
+        search = emu->createSearch();
+        printf("RAM search: %zu candidates\n", search->candidates());
+    } else {
+        size_t left = search->filter(op);
+        printf("RAM search: %zu candidates\n", left);
+        for (RamSearch::Result const &r : search->results(8))
+            printf("  %04X (bank %d): %02X -> %02X\n", r.address, r.bank, r.previous, r.value);
+    }
+}
+
+void Frontend::playAudio() {
+    if (audio == NULL)
+        return;
+
+    size_t frames;
+    int16_t const *samples = emu->getAudio(&frames);
+    emu->setAudioRatio(audio->push(samples, frames));
+}
+
+void Frontend::printStats() {
+    if (!print_stats.exchange(false))
+        return;
+
+    FramePacer::Stats frames = pacer.stats();
+    printf("Frames: %ld, %.2f ms apart (jitter %.2f ms, worst %.2f ms), %ld late\n",
+           frames.frames, frames.mean_ms, frames.jitter_ms, frames.worst_ms, frames.late);
+    if (audio != NULL) {
+        AudioOutput::Stats stats = audio->stats();
+        printf("Audio: %zu frames queued (%d ms), %llu underruns, ratio %.4f\n",
+               stats.fill, stats.fill_ms, (unsigned long long)stats.underruns, stats.ratio);
+    }
+}
+
+// Steps through 1/4x up to 16x, and then unlimited.
+void Frontend::changeSpeed() {
+    int change = speed_change.exchange(0);
+    if (change == 0)
+        return;
+
+    double speed = pacer.getSpeed();
+    if (change > 0)
+        speed = speed == 0 ? 0 : speed >= 16 ? 0 : speed * 2;
+    else
+        speed = speed == 0 ? 16 : speed <= 0.25 ? 0.25 : speed / 2;
+    pacer.setSpeed(speed);
+
+    if (speed == 0)
+        printf("Speed: unlimited\n");
+    else
+        printf("Speed: %gx\n", speed);
+}
+
+void Frontend::changePalette() {
+    if (palette_change.exchange(false)) {
+        palette = (palette + 1) % 11;
+        emu->setPalette(palette);
+    }
+    if (profile_change.exchange(false)) {
+        color_profile = (color_profile + 1) % NUM_COLOR_PROFILES;
+        emu->setColorProfile(color_profile);
+        char const *names[] = {"raw", "GBC LCD", "GBC LCD with gamma"};
+        printf("Colors: %s\n", names[color_profile]);
+    }
+}
+
+// most frames in a row the automatic skip drops when the game is slow
+#define MAX_AUTO_SKIP 4
+
+bool Frontend::drawNext(bool fast) {
+    bool draw;
+    if (frame_skip >= 0) {
+        draw = skipped >= frame_skip;
+    } else if (fast) {
+        // no point drawing faster than a 60 Hz display shows
+        draw = chrono::steady_clock::now() - last_drawn >= chrono::microseconds(16667);
+    } else {
+        draw = !pacer.behind() || skipped >= MAX_AUTO_SKIP;
+    }
+
+    if (draw) {
+        skipped = 0;
+        last_drawn = chrono::steady_clock::now();
+    } else {
+        skipped++;
+    }
+    return draw;
+}
+
+// The game thread: runs frames at the right pace and does everything that
+// touches the emulator.
+void Frontend::emulate() {
+    while (!key_map[8]) {
+        // rewinding just walks back through the saved states, one a frame,
+        // without running (or showing, or playing) anything in between
+        if (key_map[12]) {
+            if (emu->rewindFrame() == 0)
+                stopRecording("rewound");
+            pacer.wait();
+            handleHotkeys();
+            continue;
+        }
+
+        uint8_t buttons = updateButtons();
+        if (recording)
+            movie.record(buttons);
+
+        // skipped frames run with exact timing, they just don't get
+        // drawn or handed over, and neither do frames that came out the
+        // same as the last one
+        bool turbo = key_map[9];
+        bool draw = drawNext(turbo || pacer.getSpeed() == 0 || pacer.getSpeed() > 1);
+        emu->stepFrame(draw);
+        bool lines[144];
+        if (draw && emu->takeDirtyLines(lines) > 0) {
+            memcpy(frames.back(), emu->getFramebuffer(), 160 * 144 * sizeof(uint32_t));
+            frames.publish(lines);
+        }
+        if (draw && !video_file.empty())
+            video.write(emu->getFramebuffer(), frame_count);
+        frame_count++;
+
+        // sound only plays at normal speed; the rest of the time the
+        // queue would just overflow or run dry
+        if (!turbo && pacer.getSpeed() == 1)
+            playAudio();
+
+        if (turbo)
+            pacer.skip();
+        else
+            pacer.wait();
+
+        handleHotkeys();
+        runSearch();
+        printStats();
+        changeSpeed();
+        changePalette();
+
+        emu->recordFrame();
+    }
+}
+
+int Frontend::run(string file) {
+    if (emu->start(file))
+        return 1;
+
+    emu->printROMinfo();
+    if (init())
+        return 1;
+    SDL_RenderClear(renderer);
+
+    emulation = thread(&Frontend::emulate, this);
+    while (!key_map[8]) {
+        pollInput();
+        // with vsync on, presenting waits for the display, which is fine
+        // now that the game doesn't wait with it
+        bool fresh = frames.update();
+        if (fresh || redraw) {
+            present(fresh);
+            redraw = false;
+        } else {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+    emulation.join();
+    stopRecording("quit");
+
+    close();
+    return 0;
+}
@@ -0,0 +1,118 @@
+#ifndef FRONTEND_H
+#define FRONTEND_H
+
+#include "SDL.h"
+#include "Emulator.h"
+#include "AudioOutput.h"
+#include "FramePacer.h"
+#include "TripleBuffer.h"
+#include "Scaler.h"
+#include "VideoWriter.h"
+#include "Movie.h"
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+// The SDL side of things: a window to show frames in, the keyboard, and
+// keeping the game at 60 frames per second. The game runs on a thread of
+// its own and passes finished frames through a triple buffer, so a slow
+// present (vsync, a busy compositor) never holds up the emulation. The
+// window thread polls input and shows whichever frame is newest.
+class Frontend {
+public:
+    Frontend(Emulator *emu);
+    ~Frontend();
+    int run(string file);
+    // how much sound to keep queued, 0 for none at all
+    void setAudioLatency(int ms);
+    // 1 is normal speed, 0 as fast as it goes
+    void setSpeed(double speed);
+    // presents in step with the display so frames don't tear
+    void setVsync(bool enabled);
+    // draws one frame in every skip+1, or -1 to skip only when needed:
+    // while fast forwarding, frames the display couldn't show anyway, and
+    // at normal speed, frames that would make the game fall behind
+    void setFrameSkip(int skip);
+    void setColorProfile(int profile);
+    // SCALER_NONE leaves scaling to SDL, the rest do it on the CPU
+    void setScaler(int filter);
+    // records every frame drawn, see VideoWriter
+    void setVideoFile(string file);
+    // records the buttons pressed on every frame, for playing back with
+    // -f or -t
+    void setMovieFile(string file);
+
+private:
+    Emulator *emu;
+
+    SDL_Window* window = NULL;
+    SDL_Renderer* renderer = NULL;
+    SDL_Texture* texture = NULL;
+    AudioOutput* audio = NULL;
+    int audio_latency = 20;
+
+    // Set by the window thread, acted on by the game thread. 0-7 are the
+    // Game Boy buttons, then quit, turbo, save state, load state and
+    // rewind
+    atomic<bool> key_map[13] = {};
+    atomic<int> state_slot{0};
+
+    TripleBuffer frames;
+    thread emulation;
+    void emulate();
+
+    // RAM search on F1 (start over), F2 (changed), F3 (unchanged),
+    // F4 (increased) and F6 (decreased)
+    RamSearch *search = NULL;
+    atomic<int> search_op{-1};
+    void runSearch();
+
+    // F7 prints how the audio queue and frame pacing are doing
+    atomic<bool> print_stats{false};
+    void playAudio();
+    void printStats();
+
+    // - and = halve and double the speed
+    FramePacer pacer;
+    bool vsync = false;
+    atomic<int> speed_change{0};
+    void changeSpeed();
+
+    // F9 goes to the next DMG color scheme, F10 to the next CGB color
+    // correction
+    int palette = 0;
+    int color_profile = COLOR_RAW;
+    atomic<bool> palette_change{false};
+    atomic<bool> profile_change{false};
+    void changePalette();
+
+    string video_file;
+    VideoWriter video;
+    uint64_t frame_count = 0;
+    string movie_file;
+    Movie movie;
+    bool recording = false;
+    void stopRecording(char const *why);
+
+    int frame_skip = -1;
+    int skipped = 0;
+    chrono::steady_clock::time_point last_drawn;
+    bool drawNext(bool fast);
+
+    int init();
+    void close();
+    // only the rows that changed are scaled and uploaded, and frames that
+    // didn't change at all aren't presented
+    Scaler scaler{160, 144};
+    bool uploaded = false;
+    bool redraw = false;
+    void present(bool upload);
+    void pollInput();
+    uint8_t updateButtons();
+    void handleHotkeys();
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include "Hash.h"
+#include <string.h>
+
+static uint64_t const PRIME1 = 0x9E3779B185EBCA87ULL;
+static uint64_t const PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static uint64_t const PRIME3 = 0x165667B19E3779F9ULL;
+static uint64_t const PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static uint64_t const PRIME5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// little endian loads; memcpy keeps them legal at any alignment
+static inline uint64_t read64(uint8_t const *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(uint8_t const *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t mix(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    return rotl(acc, 31) * PRIME1;
+}
+
+static inline uint64_t merge(uint64_t h, uint64_t acc) {
+    h ^= mix(0, acc);
+    return h * PRIME1 + PRIME4;
+}
+
+uint64_t Hash::xxh64(void const *data, size_t size, uint64_t seed) {
+    uint8_t const *p = (uint8_t const *)data;
+    uint8_t const *end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        // four independent lanes over 32 byte stripes
+        uint64_t v1 = seed + PRIME1 + PRIME2, v2 = seed + PRIME2;
+        uint64_t v3 = seed, v4 = seed - PRIME1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = mix(v1, read64(p));
+            v2 = mix(v2, read64(p + 8));
+            v3 = mix(v3, read64(p + 16));
+            v4 = mix(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge(h, v1);
+        h = merge(h, v2);
+        h = merge(h, v3);
+        h = merge(h, v4);
+    } else {
+        h = seed + PRIME5;
+    }
+    h += size;
+
+    for (; p + 8 <= end; p += 8)
+        h = rotl(h ^ mix(0, read64(p)), 27) * PRIME1 + PRIME4;
+    if (p + 4 <= end) {
+        h = rotl(h ^ (read32(p) * PRIME1), 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++)
+        h = rotl(h ^ (*p * PRIME5), 11) * PRIME1;
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
@@ -0,0 +1,14 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// XXH64, a fast non-cryptographic 64-bit hash (about as fast as memory can
+// be read), for telling frames and machine states apart.
+class Hash {
+public:
+    static uint64_t xxh64(void const *data, size_t size, uint64_t seed = 0);
+};
+
+#endif
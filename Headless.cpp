@@ -0,0 +1,61 @@
+#include "Headless.h"
+#include <stdio.h>
+
+Headless::Headless(Emulator *emu) {
+    this->emu = emu;
+}
+
+void Headless::setAudioFile(string file) {
+    audio_file = file;
+}
+
+void Headless::setVideoFile(string file) {
+    video_file = file;
+}
+
+void Headless::setMovieFile(string file) {
+    movie_file = file;
+}
+
+int Headless::run(string file, int frames) {
+    // samples are only made if they're going somewhere; the hash is
+    // there either way
+    emu->setSaveFile(false);
+    emu->setAudio(!audio_file.empty());
+    emu->setAudioHash(true);
+    if (!movie_file.empty() && movie.load(movie_file))
+        return 1;
+    emu->setFixedClock(FIXED_CLOCK_START);
+    if (emu->start(file))
+        return 1;
+
+    if (!audio_file.empty() && writer.open(audio_file, emu->getSampleRate()))
+        return 1;
+    // nothing is keeping time here, so no frame needs to be dropped
+    video.setWait(true);
+    if (!video_file.empty() && video.open(video_file))
+        return 1;
+
+    uint64_t audio_hash = 14695981039346656037ULL;
+    uint64_t video_hash = 14695981039346656037ULL;
+    for (int i=0; i<frames; i++) {
+        emu->setButtons(movie.buttons(i));
+        emu->runFrame(true);
+        audio_hash = (audio_hash ^ emu->getAudioHash()) * 1099511628211ULL;
+        video_hash = (video_hash ^ emu->frameHash()) * 1099511628211ULL;
+
+        if (!audio_file.empty()) {
+            size_t count;
+            int16_t const *samples = emu->getAudio(&count);
+            writer.write(samples, count);
+        }
+        if (!video_file.empty())
+            video.write(emu->getFramebuffer(), i);
+    }
+
+    if (writer.close() | video.close())
+        return 1;
+    printf("Ran %d frames, audio hash %016llx, video hash %016llx\n", frames,
+           (unsigned long long)audio_hash, (unsigned long long)video_hash);
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "Emulator.h"
+#include "AudioWriter.h"
+#include "VideoWriter.h"
+#include "Movie.h"
+#include <string>
+
+using namespace std;
+
+// Runs a game for a set number of frames with no window and no sound
+// card, for checking on build machines that it still behaves the same.
+// Nothing is pressed unless there's a movie to play back, the save file is
+// left alone and the game's clock doesn't follow the wall clock.
+class Headless {
+public:
+    Headless(Emulator *emu);
+    // audio_file, if given, gets the sound as a WAV (or raw PCM) file
+    void setAudioFile(string file);
+    // video_file, if given, gets the picture, see VideoWriter
+    void setVideoFile(string file);
+    void setMovieFile(string file);
+    int run(string file, int frames);
+
+private:
+    Emulator *emu;
+    string audio_file;
+    AudioWriter writer;
+    string video_file;
+    VideoWriter video;
+    string movie_file;
+    Movie movie;
+};
+
+#endif
@@ -14,11 +14,11 @@ void Logger::open(char const *file_name) {
 }
 
 void Logger::writeLog(CPU *cpu) {
-    fprintf(file, FORMAT, cpu->readR8(7), cpu->af & 0xff, 
+    fprintf(file, FORMAT, cpu->readR8(7), cpu->regs->af & 0xff, 
             cpu->readR8(0), cpu->readR8(1), cpu->readR8(2), cpu->readR8(3),
-            cpu->readR8(4), cpu->readR8(5), cpu->sp, cpu->pc, 
-            cpu->read(cpu->pc), cpu->read(cpu->pc+1), cpu->read(cpu->pc+2), 
-            cpu->read(cpu->pc+3));
+            cpu->readR8(4), cpu->readR8(5), cpu->regs->sp, cpu->regs->pc, 
+            cpu->read(cpu->regs->pc), cpu->read(cpu->regs->pc+1), cpu->read(cpu->regs->pc+2), 
+            cpu->read(cpu->regs->pc+3));
 }
 
 void Logger::close() {
@@ -0,0 +1,38 @@
+#include "MachineState.h"
+#include <sys/mman.h>
+#include <string.h>
+#include <new>
+
+MachineState *MachineState::create() {
+    // anonymous pages come back zeroed and page aligned, and stay free
+    // until touched, so a fork only pays for the banks it writes
+    void *block = mmap(NULL, sizeof(MachineState), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+        return NULL;
+
+    MachineState *state = new (block) MachineState;
+    state->defaults();
+    return state;
+}
+
+void MachineState::destroy(MachineState *state) {
+    if (state != NULL)
+        munmap(state, sizeof(MachineState));
+}
+
+// Everything else starts out zero.
+void MachineState::defaults() {
+    cpu.booting = true;
+    cpu.speed = 4;
+    cpu.WRAM_bank = 1;
+    cpu.ready_for_hblank_DMA = true;
+
+    mbc.ROM_bank_number = 1;
+    mbc.latck_clock_register = 0xff;
+
+    ppu.obj_h = 8;
+
+    apu.seq_timer = 8192;
+    apu.lfsr = 0x7fff;
+}
@@ -0,0 +1,135 @@
+#ifndef MACHINE_STATE_H
+#define MACHINE_STATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct sprite {
+    uint8_t y_pos;
+    uint8_t x_pos;
+    uint8_t tile_ID;
+    uint8_t flags;
+};
+
+struct CPUState {
+    // Registers
+    uint16_t pc;
+    uint16_t sp;
+    uint16_t af;
+    uint16_t bc;
+    uint16_t de;
+    uint16_t hl;
+
+    // Interrupt master enable flag [write only]
+    bool IME;
+    uint8_t ei_timer;
+    bool halt;
+    bool halt_bug;
+
+    bool booting;
+    int speed;
+    int VRAM_bank;
+    int WRAM_bank;
+    int t_cycle_backlog;
+
+    int32_t m_cycles_for_div;
+    int32_t m_cycles_for_tima;
+
+    bool in_DMA_transfer;
+    uint16_t DMA_source_base;
+    uint16_t DMA_add;
+
+    bool in_HDMA_transfer;
+    bool hblank_DMA;
+    bool ready_for_hblank_DMA;
+    int data_transferred;
+
+    // dots since power on at normal speed, which the RTC goes by when it
+    // isn't following the wall clock (see CPU::fixed_clock)
+    uint64_t dots;
+};
+
+// MBC write-only variables
+struct MapperState {
+    uint8_t RAM_enable;
+    uint16_t RAM_bank_number;
+    uint16_t ROM_bank_number;
+    bool ROM_RAM_mode_select;
+    int EXT_RAM_bank;
+
+    uint8_t clock_registers[16];
+    uint8_t latck_clock_register;
+};
+
+struct PPUState {
+    uint8_t lcdc;
+    uint8_t ly, lyc, stat;
+    uint8_t scx, scy;
+    int wy, wx;
+    int obj_h;
+    bool bg_priority;
+
+    int bgp_mapping[4];
+    int obp0_mapping[4];
+    int obp1_mapping[4];
+
+    int mode;
+    int scanline_dot;
+    int curX;
+
+    struct sprite obj_on_line[10];
+    int cur_obj;
+    int scanline_objs_colors[160];
+    int obj_colors_earliest_x[160];
+    bool obj_priority[160];
+};
+
+struct SoundChannel {
+    bool enabled;
+    int length;
+    int volume;
+    int env_timer;
+    int timer;      // dots until the next waveform step
+    int pos;        // duty step, wave sample
+};
+
+struct APUState {
+    int pending;    // dots gone by since the channels last caught up
+    int seq_timer;
+    int seq_step;
+
+    struct SoundChannel ch[4];
+    int sweep_timer;
+    int shadow_freq;
+    bool sweep_enabled;
+    uint16_t lfsr;
+};
+
+// Every piece of mutable machine state except the battery-backed external
+// RAM (which is mapped from the save file, see ROM), in one page-aligned
+// block. The CPU's memory bus pointers are derived from it, so copying or
+// hashing the machine is a single pass over sizeof(MachineState) bytes.
+struct alignas(64) MachineState {
+    CPUState cpu;
+    MapperState mbc;
+    PPUState ppu;
+    APUState apu;
+
+    // CGB palette RAM, turned into pixels by the PPU (see Palette)
+    uint8_t OBJ_COLOR[64];
+    uint8_t BG_COLOR[64];
+
+    uint8_t IO_registers[0x80];
+    uint8_t HRAM[0x7F];
+    uint8_t IE;
+    uint8_t OAM[0xA0];
+
+    alignas(4096) uint8_t VRAM[2][0x2000];
+    uint8_t WRAM[8][0x1000];
+
+    static MachineState *create();
+    static void destroy(MachineState *state);
+    void defaults();
+};
+
+#endif
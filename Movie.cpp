@@ -0,0 +1,54 @@
+#include "Movie.h"
+#include <stdio.h>
+#include <string.h>
+
+int Movie::load(string file) {
+    FILE *f = fopen(file.c_str(), "rb");
+    if (f == NULL) {
+        printf("Couldn't open movie %s\n", file.c_str());
+        return 1;
+    }
+
+    char magic[4];
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, MOVIE_MAGIC, 4) != 0) {
+        printf("%s isn't a movie\n", file.c_str());
+        fclose(f);
+        return 1;
+    }
+
+    frames.clear();
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        frames.insert(frames.end(), chunk, chunk + n);
+    fclose(f);
+    return 0;
+}
+
+int Movie::save(string file) {
+    FILE *f = fopen(file.c_str(), "wb");
+    if (f == NULL) {
+        printf("Couldn't write movie %s\n", file.c_str());
+        return 1;
+    }
+
+    bool ok = fwrite(MOVIE_MAGIC, 1, 4, f) == 4 &&
+              fwrite(frames.data(), 1, frames.size(), f) == frames.size();
+    if (fclose(f) != 0 || !ok) {
+        printf("Couldn't write movie %s\n", file.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+void Movie::record(uint8_t buttons) {
+    frames.push_back(buttons);
+}
+
+size_t Movie::length() {
+    return frames.size();
+}
+
+uint8_t Movie::buttons(size_t frame) {
+    return frame < frames.size() ? frames[frame] : 0;
+}
@@ -0,0 +1,28 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define MOVIE_MAGIC "GBMV"
+
+// The buttons held on each frame of a run from power on, so it can be
+// played back exactly. On disk it's the 4 byte magic and then one byte per
+// frame, in setButtons order.
+class Movie {
+public:
+    int load(string file);
+    int save(string file);
+    void record(uint8_t buttons);
+    size_t length();
+    // nothing is pressed after the end
+    uint8_t buttons(size_t frame);
+
+private:
+    vector<uint8_t> frames;
+};
+
+#endif
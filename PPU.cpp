@@ -1,44 +1,30 @@
 #include "PPU.h"
+#include "FrameObserver.h"
 #include <thread>
 #include <stdio.h>
 #include <time.h>
+#include <sys/mman.h>
+#include <new>
 
 PPU::PPU() {
+    void *block = mmap(NULL, sizeof(PPUFrames), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    // the same as new running out of memory
+    if (block == MAP_FAILED)
+        throw bad_alloc();
+    frames = (PPUFrames*)block;
+    index_frame = frames->index_frame;
+    line_palettes = frames->line_palettes;
+    gray_frame = frames->gray_frame;
+    framebuffer = frames->framebuffer;
 }
 
 PPU::~PPU() {
-    close();
+    munmap(frames, sizeof(PPUFrames));
 }
 
 void PPU::init(CPU *cpu) {
-    if (SDL_Init(SDL_INIT_VIDEO) != 0){
-        std::cout << "SDL_Init Error: " << SDL_GetError() << std::endl;
-        return ;
-    }
-    window = SDL_CreateWindow("C8emu", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WIDTH, HEIGHT, SDL_WINDOW_SHOWN);
-    if (window == NULL){
-        std::cout << "SDL_CreateWindow Error: " << SDL_GetError() << std::endl;
-        return ;
-    }
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    if (renderer == NULL) {
-        printf( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
-        return ;
-    } else {
-        SDL_SetRenderDrawColor( renderer, 0x00, 0x00, 0x00, 0xFF );
-    }
-    surface = SDL_CreateRGBSurface(0, 160, 144, 32, 0, 0, 0, 0);
-    if (surface == NULL){
-        std::cout << "SDL_CreateRGBSurface Error: " << SDL_GetError() << std::endl;
-        return ;
-    }
-    texture = SDL_CreateTextureFromSurface(renderer, surface);
-    if (texture == NULL){
-        std::cout << "SDL_CreateTextureFromSurface Error: " << SDL_GetError() << std::endl;
-        return ;
-    }
-
     this->cpu = cpu;
+    mapState();
     if (!cpu->color_on) {
         this->color_on = false;
         selectPalette(0);
@@ -51,39 +37,73 @@ void PPU::init(CPU *cpu) {
     }
 }
 
+// The PPU's line state lives in the CPU's arena, which moves when the CPU
+// forks.
+void PPU::mapState() {
+    machine = cpu->state;
+    lcd = &machine->ppu;
+}
+
 void PPU::selectPalette(int palette) {
     for (int i=0; i<4; i++)
         colors[i] = palettes[palette][i];
 }
 
-void PPU::close() {
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
-    renderer = NULL;
-    window = NULL;
-    surface = NULL;
-    texture = NULL;
-
-    SDL_Quit();
+// Picks one of the DMG color schemes. Nothing needs to be drawn again,
+// every line just gets resolved with the new colors.
+void PPU::setPalette(int palette) {
+    selectPalette(((palette % num_palettes) + num_palettes) % num_palettes);
+    for (int y=0; y<144; y++) {
+        stale[y] = drawn[y];
+        dirty[y] = dirty[y] || drawn[y];
+    }
+}
+
+void PPU::setColorProfile(int profile) {
+    color_profile = profile;
+    cgb_colors_valid = false;
+    for (int y=0; y<144; y++) {
+        stale[y] = drawn[y];
+        dirty[y] = dirty[y] || drawn[y];
+    }
+}
+
+// The ARGB colors line y's indices stand for. Most games set up the CGB
+// palettes once per scene, so the table only gets rebuilt when a line's
+// palette snapshot differs from the last one.
+uint32_t const *PPU::lineColors(int y) {
+    if (!color_on)
+        return colors;
+
+    uint8_t const *palette = line_palettes[y];
+    if (!cgb_colors_valid || memcmp(cached_palette, palette, sizeof(cached_palette)) != 0) {
+        memcpy(cached_palette, palette, sizeof(cached_palette));
+        for (int i=0; i<64; i++)
+            cgb_colors[i] = Palette::fromRGB555(palette[2*i] | (palette[2*i+1] << 8), color_profile);
+        cgb_colors[64] = 0xffffffff;
+        cgb_colors_valid = true;
+    }
+    return cgb_colors;
 }
 
-void PPU::set_pixel(SDL_Surface *surface, int x, int y, Uint32 pixel)
-{
-  Uint32 * const target_pixel = (Uint32 *) ((Uint8 *) surface->pixels
-                                             + y * surface->pitch
-                                             + x * surface->format->BytesPerPixel);
-  *target_pixel = pixel;
+uint32_t const *PPU::getFramebuffer() {
+    for (int y=0; y<144; y++) {
+        if (!stale[y])
+            continue;
+        Palette::resolve(index_frame + y * 160, lineColors(y), color_on ? 65 : 4,
+                         framebuffer + y * 160, 160);
+        stale[y] = false;
+    }
+    return framebuffer;
 }
 
 void PPU::writeObjLine(struct sprite obj) {
     int trueX = obj.x_pos - 8, trueY = obj.y_pos - 16;
     bool upper, lower;
-    uint8_t subRow = ly - trueY;
-    if (obj.flags & 0x40) subRow = obj_h - subRow - 1;
+    uint8_t subRow = lcd->ly - trueY;
+    if (obj.flags & 0x40) subRow = lcd->obj_h - subRow - 1;
 
-    if (obj_h == 16) { // handle 8x16 object tilings
+    if (lcd->obj_h == 16) { // handle 8x16 object tilings
         if (subRow >= 8) {
             obj.tile_ID |= 0x01;
             subRow -= 8;
@@ -96,8 +116,8 @@ void PPU::writeObjLine(struct sprite obj) {
     uint8_t byte2 = cpu->readVRAM(0x8000 + (obj.tile_ID << 4) + 2*subRow + 1,  color_on && (obj.flags & 0x08));
 
     for (int i=std::max(0, -trueX); i<8 && i+trueX<160; i++) {
-        if ((obj_colors_earliest_x[trueX+i] > trueX && !color_on) || 
-            (obj_colors_earliest_x[trueX+i] == 0xff &&  color_on)) {
+        if ((lcd->obj_colors_earliest_x[trueX+i] > trueX && !color_on) || 
+            (lcd->obj_colors_earliest_x[trueX+i] == 0xff &&  color_on)) {
             if (obj.flags & 0x20) {
                 lower = (byte1 & (0x1 << i)) > 0;
                 upper = (byte2 & (0x1 << i)) > 0;
@@ -110,20 +130,20 @@ void PPU::writeObjLine(struct sprite obj) {
             if (colorID) {
                 if (!color_on) {
                     if (obj.flags & 0x08)
-                        scanline_objs_colors[trueX+i] = obp1_mapping[colorID];
+                        lcd->scanline_objs_colors[trueX+i] = lcd->obp1_mapping[colorID];
                     else
-                        scanline_objs_colors[trueX+i] = obp0_mapping[colorID];
+                        lcd->scanline_objs_colors[trueX+i] = lcd->obp0_mapping[colorID];
                 } else if (color_on_colorless) {
                     if (obj.flags & 0x08)
-                        scanline_objs_colors[trueX+i] = obp1_mapping[colorID]+4;
+                        lcd->scanline_objs_colors[trueX+i] = lcd->obp1_mapping[colorID]+4;
                     else
-                        scanline_objs_colors[trueX+i] = obp0_mapping[colorID];
+                        lcd->scanline_objs_colors[trueX+i] = lcd->obp0_mapping[colorID];
                 } else {
-                    scanline_objs_colors[trueX+i] = ((obj.flags & 0x07) * 4) + colorID;
+                    lcd->scanline_objs_colors[trueX+i] = ((obj.flags & 0x07) * 4) + colorID;
                 }
                 
-                obj_colors_earliest_x[trueX+i] = trueX;
-                obj_priority[trueX+i] = (obj.flags & 0x80);
+                lcd->obj_colors_earliest_x[trueX+i] = trueX;
+                lcd->obj_priority[trueX+i] = (obj.flags & 0x80);
             }
         }
     }
@@ -131,9 +151,9 @@ void PPU::writeObjLine(struct sprite obj) {
 
 void PPU::prepObjLine() {
     for (int i=0; i<160; i++) {
-        scanline_objs_colors[i] = 0;
-        obj_colors_earliest_x[i] = 0xff;
-        obj_priority[i] = 0;
+        lcd->scanline_objs_colors[i] = 0;
+        lcd->obj_colors_earliest_x[i] = 0xff;
+        lcd->obj_priority[i] = 0;
     }
 }
 
@@ -144,15 +164,15 @@ void PPU::recomputeMapping(int target) {
     switch (target) {
         case 0:
             descr = cpu->read(0xff47);
-            mapping = bgp_mapping;
+            mapping = lcd->bgp_mapping;
             break;
         case 1:
             descr = cpu->read(0xff48);
-            mapping = obp0_mapping;
+            mapping = lcd->obp0_mapping;
             break;
         case 2:
             descr = cpu->read(0xff49);
-            mapping = obp1_mapping;
+            mapping = lcd->obp1_mapping;
             break;
     }
     
@@ -164,11 +184,11 @@ void PPU::recomputeMapping(int target) {
 }
 
 int PPU::getWindowColorID(int x, int y) {
-    int trueX = x-wx+7, trueY = y-wy;
+    int trueX = x-lcd->wx+7, trueY = y-lcd->wy;
     int tileX = trueX / 8, tileY = trueY / 8;
     int subX = trueX % 8, subY = trueY % 8;
 
-    uint16_t extra = (lcdc & 0x40) ? 0x0400 : 0x0000;
+    uint16_t extra = (lcd->lcdc & 0x40) ? 0x0400 : 0x0000;
     uint16_t tileID = cpu->readVRAM(0x9800 + tileX + 0x20*tileY + extra, 0);
     uint16_t tile_Attr = 0;
     if (color_on) {
@@ -177,24 +197,24 @@ int PPU::getWindowColorID(int x, int y) {
         if (tile_Attr & 0x20) subX = 7 - subX;
     }
 
-    extra = (lcdc & 0x10) || tileID >= 0x80 ? 0x0000 : 0x1000;
+    extra = (lcd->lcdc & 0x10) || tileID >= 0x80 ? 0x0000 : 0x1000;
     uint8_t byte1 = cpu->readVRAM(0x8000 + (tileID << 4) + 2*subY + extra,     (tile_Attr & 0x08) > 0);
     uint8_t byte2 = cpu->readVRAM(0x8000 + (tileID << 4) + 2*subY + 1 + extra, (tile_Attr & 0x08) > 0);
 
     bool lower = (byte1 & (0x1 << (7-subX))) > 0;
     bool upper = (byte2 & (0x1 << (7-subX))) > 0;
-    bg_priority = (tile_Attr & 0x80) && (lower || upper);
+    lcd->bg_priority = (tile_Attr & 0x80) && (lower || upper);
 
     if (color_on) return ((tile_Attr & 0x07) << 2) + lower + upper*2;
     return lower | (upper << 1);
 }
 
 int PPU::getBackgroundColorID(int x, int y) {
-    int trueX = (x + scx) % 256, trueY = (y + scy) % 256;
+    int trueX = (x + lcd->scx) % 256, trueY = (y + lcd->scy) % 256;
     int tileX = trueX / 8, tileY = trueY / 8;
     int subX = trueX % 8, subY = trueY % 8;
 
-    uint16_t extra = (lcdc & 0x08) ? 0x0400 : 0x0000;
+    uint16_t extra = (lcd->lcdc & 0x08) ? 0x0400 : 0x0000;
     uint16_t tileID = cpu->readVRAM(0x9800 + tileX + 0x20*tileY + extra, 0);
     uint16_t tile_Attr = 0;
     if (color_on) {
@@ -203,210 +223,249 @@ int PPU::getBackgroundColorID(int x, int y) {
         if (tile_Attr & 0x20) subX = 7 - subX;
     }
 
-    extra = (lcdc & 0x10) || tileID >= 0x80 ? 0x0000 : 0x1000;
+    extra = (lcd->lcdc & 0x10) || tileID >= 0x80 ? 0x0000 : 0x1000;
     uint8_t byte1 = cpu->readVRAM(0x8000 + (tileID << 4) + 2*subY + extra,     (tile_Attr & 0x08) > 0);
     uint8_t byte2 = cpu->readVRAM(0x8000 + (tileID << 4) + 2*subY + 1 + extra, (tile_Attr & 0x08) > 0);
 
     bool lower = (byte1 & (0x1 << (7-subX))) > 0;
     bool upper = (byte2 & (0x1 << (7-subX))) > 0;
-    bg_priority = (tile_Attr & 0x80) && (lower || upper);
+    lcd->bg_priority = (tile_Attr & 0x80) && (lower || upper);
     
     if (color_on) {
-        if (color_on_colorless) return bgp_mapping[lower | upper * 2];
+        if (color_on_colorless) return lcd->bgp_mapping[lower | upper * 2];
         return ((tile_Attr & 0x07) << 2) + lower + upper*2;
     }
     return lower | (upper << 1);
 }
 
 void PPU::find_and_set_pixel(int x, int y) {
-    int final_color;
+    uint8_t index;
     uint8_t colorID;
-    if ((lcdc & 0x20) && wx-7 <= x && wy <= y) {
+    if ((lcd->lcdc & 0x20) && lcd->wx-7 <= x && lcd->wy <= y) {
         colorID = getWindowColorID(x, y);
     } else {
         colorID = getBackgroundColorID(x, y);
     }
 
-    if (!(lcdc & 0x80)) {
+    if (!(lcd->lcdc & 0x80)) {
         if (color_on) {
-            final_color = 0xffffffff;
+            index = 64;
         }
         else {
-            final_color = colors[0];
+            index = 0;
         }
-    } else if (obj_colors_earliest_x[x] != 0xff && (lcdc & 0x02)) {
+    } else if (lcd->obj_colors_earliest_x[x] != 0xff && (lcd->lcdc & 0x02)) {
         if (color_on) {
-            if (colorID % 4 == 0 || (lcdc & 0x01) == 0 || (!obj_priority[x] && !bg_priority))
-                final_color = cpu->true_OBJ_COLOR[scanline_objs_colors[x]];
+            if (colorID % 4 == 0 || (lcd->lcdc & 0x01) == 0 || (!lcd->obj_priority[x] && !lcd->bg_priority))
+                index = 32 + lcd->scanline_objs_colors[x];
             else
-                final_color = cpu->true_BG_COLOR[colorID];
+                index = colorID;
         }
-        else if (!obj_priority[x]) {
-            final_color = colors[scanline_objs_colors[x]];
+        else if (!lcd->obj_priority[x]) {
+            index = lcd->scanline_objs_colors[x];
         }
         else {
-            if (bgp_mapping[colorID] != 0) {
-                final_color = colors[bgp_mapping[colorID]];
-            } else if (color_on) {
-                final_color = colors[scanline_objs_colors[x]];
+            // behind the background, so it only shows through color 0
+            if (lcd->bgp_mapping[colorID] != 0) {
+                index = lcd->bgp_mapping[colorID];
+            } else {
+                index = lcd->scanline_objs_colors[x];
             }
         }
-    } else if (!(lcdc & 0x01) && !color_on) {
-        final_color = colors[0];
+    } else if (!(lcd->lcdc & 0x01) && !color_on) {
+        index = 0;
     } else {
         if (color_on)
-            final_color = cpu->true_BG_COLOR[colorID];
+            index = colorID;
         else
-            final_color = colors[bgp_mapping[colorID]];
+            index = lcd->bgp_mapping[colorID];
     }
 
-    set_pixel(surface, x, y, final_color);
+    index_line[x] = index;
 }
 
 void PPU::dot(int t_cycle_backlog) {
     if (!(cpu->read(0xff40) & 0x80)) return;
 
     while (t_cycle_backlog --> 0) {
-        switch (mode) {
+        switch (lcd->mode) {
             case 0:
-                scanline_dot++;
-                if (scanline_dot >= 376) {
-                    ly++;
-                    cpu->write(0xff44, ly);
-                    scanline_dot = 0;
-                    curX = 0;
-
-                    stat = cpu->read(0xff41);
-                    lyc = cpu->read(0xff45);
-                    if (lyc == ly) {
-                        stat |= 0x04;
-                        cpu->overrideSTAT(stat);
-                        if (stat & 0x40)
+                lcd->scanline_dot++;
+                if (lcd->scanline_dot >= 376) {
+                    lcd->ly++;
+                    cpu->write(0xff44, lcd->ly);
+                    lcd->scanline_dot = 0;
+                    lcd->curX = 0;
+
+                    lcd->stat = cpu->read(0xff41);
+                    lcd->lyc = cpu->read(0xff45);
+                    if (lcd->lyc == lcd->ly) {
+                        lcd->stat |= 0x04;
+                        cpu->overrideSTAT(lcd->stat);
+                        if (lcd->stat & 0x40)
                             cpu->write(0xff0f, cpu->read(0xff0f) | 0x02);
                     } else {
-                        stat &= 0xfb;
-                        cpu->overrideSTAT(stat);
+                        lcd->stat &= 0xfb;
+                        cpu->overrideSTAT(lcd->stat);
                     }
 
-                    if (ly >= 144) {
-                        mode = 1;
+                    if (lcd->ly >= 144) {
+                        lcd->mode = 1;
                         frame_ready = true;
 
                         // update STAT
-                        stat = cpu->read(0xff41);
-                        stat &= 0xfc;
-                        stat |= 1;
-                        cpu->overrideSTAT(stat);
-                        if (stat & 0x10)
+                        lcd->stat = cpu->read(0xff41);
+                        lcd->stat &= 0xfc;
+                        lcd->stat |= 1;
+                        cpu->overrideSTAT(lcd->stat);
+                        if (lcd->stat & 0x10)
                             cpu->write(0xff0f, cpu->read(0xff0f) | 0x02);
 
                         // send out VBlank interrupt request
                         cpu->write(0xff0f, cpu->read(0xff0f) | 0x01);
                     } else {
-                        mode = 2;
-                        cur_obj = 0;
+                        lcd->mode = 2;
+                        lcd->cur_obj = 0;
                         prepObjLine();
-                        lcdc = cpu->read(0xff40);
-                        obj_h = (lcdc & 0x04) ? 16 : 8;
+                        lcd->lcdc = cpu->read(0xff40);
+                        lcd->obj_h = (lcd->lcdc & 0x04) ? 16 : 8;
                         
                         // update STAT
-                        stat = cpu->read(0xff41);
-                        stat &= 0xfc;
-                        stat |= 2;
-                        cpu->overrideSTAT(stat);
-                        if (stat & 0x20)
+                        lcd->stat = cpu->read(0xff41);
+                        lcd->stat &= 0xfc;
+                        lcd->stat |= 2;
+                        cpu->overrideSTAT(lcd->stat);
+                        if (lcd->stat & 0x20)
                             cpu->write(0xff0f, cpu->read(0xff0f) | 0x02);
                     }
                 }
                 break;
             case 1:
-                scanline_dot++;
-                if (scanline_dot >= 456) {
-                    ly++;
-                    scanline_dot = 0;
-                    cur_obj = 0;
-
-                    if (ly >= 154) {
-                        ly = 0;
-                        mode = 2;
+                lcd->scanline_dot++;
+                if (lcd->scanline_dot >= 456) {
+                    lcd->ly++;
+                    lcd->scanline_dot = 0;
+                    lcd->cur_obj = 0;
+
+                    if (lcd->ly >= 154) {
+                        lcd->ly = 0;
+                        lcd->mode = 2;
                         prepObjLine();
                         recomputeMapping(1); // update OBP0
                         recomputeMapping(2); // update OBP1
-                        lcdc = cpu->read(0xff40);
-                        obj_h = (lcdc & 0x04) ? 16 : 8;
+                        lcd->lcdc = cpu->read(0xff40);
+                        lcd->obj_h = (lcd->lcdc & 0x04) ? 16 : 8;
 
                         // update STAT
-                        stat = cpu->read(0xff41);
-                        stat &= 0xfc;
-                        stat |= 2;
-                        cpu->overrideSTAT(stat);
-                        if (stat & 0x20)
+                        lcd->stat = cpu->read(0xff41);
+                        lcd->stat &= 0xfc;
+                        lcd->stat |= 2;
+                        cpu->overrideSTAT(lcd->stat);
+                        if (lcd->stat & 0x20)
                             cpu->write(0xff0f, cpu->read(0xff0f) | 0x02);
 
                         // lock OAM
                     }
 
-                    cpu->write(0xff44, ly);
-                    stat = cpu->read(0xff41);
-                    lyc = cpu->read(0xff45);
-                    if (lyc == ly) {
-                        stat |= 0x04;
-                        cpu->overrideSTAT(stat);
-                        if (stat & 0x40)
+                    cpu->write(0xff44, lcd->ly);
+                    lcd->stat = cpu->read(0xff41);
+                    lcd->lyc = cpu->read(0xff45);
+                    if (lcd->lyc == lcd->ly) {
+                        lcd->stat |= 0x04;
+                        cpu->overrideSTAT(lcd->stat);
+                        if (lcd->stat & 0x40)
                             cpu->write(0xff0f, cpu->read(0xff0f) | 0x02);
                     } else {
-                        stat &= 0xfb;
-                        cpu->overrideSTAT(stat);
+                        lcd->stat &= 0xfb;
+                        cpu->overrideSTAT(lcd->stat);
                     }
                 }
                 break;
             case 2:
-                if (scanline_dot % 2 == 0 && cur_obj < 10) {
-                    uint8_t obj_y = cpu->read(0xfe00 + scanline_dot*2);
-                    if (ly+16 >= obj_y && ly+16 < obj_y+obj_h) {
-                        obj_on_line[cur_obj].y_pos = obj_y;
-                        obj_on_line[cur_obj].x_pos = cpu->read(0xfe00 + scanline_dot*2 + 1);
-                        obj_on_line[cur_obj].tile_ID = cpu->read(0xfe00 + scanline_dot*2 + 2);
-                        obj_on_line[cur_obj].flags = cpu->read(0xfe00 + scanline_dot*2 + 3);
-
-                        writeObjLine(obj_on_line[cur_obj++]);
+                if (lcd->scanline_dot % 2 == 0 && lcd->cur_obj < 10) {
+                    uint8_t obj_y = cpu->read(0xfe00 + lcd->scanline_dot*2);
+                    if (lcd->ly+16 >= obj_y && lcd->ly+16 < obj_y+lcd->obj_h) {
+                        lcd->obj_on_line[lcd->cur_obj].y_pos = obj_y;
+                        lcd->obj_on_line[lcd->cur_obj].x_pos = cpu->read(0xfe00 + lcd->scanline_dot*2 + 1);
+                        lcd->obj_on_line[lcd->cur_obj].tile_ID = cpu->read(0xfe00 + lcd->scanline_dot*2 + 2);
+                        lcd->obj_on_line[lcd->cur_obj].flags = cpu->read(0xfe00 + lcd->scanline_dot*2 + 3);
+
+                        // part of the machine state, so done even when the
+                        // frame isn't being drawn
+                        writeObjLine(lcd->obj_on_line[lcd->cur_obj]);
+                        lcd->cur_obj++;
                     }
                 }
 
-                scanline_dot++;
-                if (scanline_dot >= 80) {
-                    scanline_dot = 0;
-                    mode = 3;
+                lcd->scanline_dot++;
+                if (lcd->scanline_dot >= 80) {
+                    lcd->scanline_dot = 0;
+                    lcd->mode = 3;
 
                     // update STAT
-                    stat = cpu->read(0xff41);
-                    stat &= 0xfc;
-                    stat |= 3;
-                    cpu->overrideSTAT(stat);
-
-                    lcdc = cpu->read(0xff40);
-                    obj_h = (lcdc & 0x04) ? 16 : 8;
-                    scy = cpu->read(0xff42);
-                    scx = cpu->read(0xff43);
-                    wy = cpu->read(0xff4a);
-                    wx = cpu->read(0xff4b);
+                    lcd->stat = cpu->read(0xff41);
+                    lcd->stat &= 0xfc;
+                    lcd->stat |= 3;
+                    cpu->overrideSTAT(lcd->stat);
+
+                    lcd->lcdc = cpu->read(0xff40);
+                    lcd->obj_h = (lcd->lcdc & 0x04) ? 16 : 8;
+                    lcd->scy = cpu->read(0xff42);
+                    lcd->scx = cpu->read(0xff43);
+                    lcd->wy = cpu->read(0xff4a);
+                    lcd->wx = cpu->read(0xff4b);
                     recomputeMapping(0);
 
                     // lock VRAM
                 }
                 break;
             case 3:
-                scanline_dot++;
-                find_and_set_pixel(curX++, ly);
-                if (curX >= 160) {
-                    mode = 0;
+                lcd->scanline_dot++;
+                // pixels only go to index_line, but each one leaves
+                // bg_priority behind in the state, so the last one of the
+                // line gets worked out anyway to keep skipped frames the same
+                if (render || lcd->curX == 159)
+                    find_and_set_pixel(lcd->curX, lcd->ly);
+                lcd->curX++;
+                if (lcd->curX >= 160) {
+                    lcd->mode = 0;
+                    if (render && gray) {
+                        if (color_on) {
+                            memcpy(line_palettes[lcd->ly], machine->BG_COLOR, 64);
+                            memcpy(line_palettes[lcd->ly] + 64, machine->OBJ_COLOR, 64);
+                        }
+                        Palette::resolve(index_line, lineColors(lcd->ly), color_on ? 65 : 4, line, 160);
+                        FrameObserver::grayLine(line, gray_frame + lcd->ly * 160, 160);
+                    } else if (render) {
+                        // only lines that actually changed get copied and
+                        // marked, so a still picture costs nothing to show.
+                        // Turning them into ARGB waits until somebody asks.
+                        int ly = lcd->ly;
+                        uint8_t *row = index_frame + ly * 160;
+                        // the first time a line is drawn counts as a change
+                        // even if it's all color 0
+                        bool changed = !drawn[ly] || memcmp(row, index_line, sizeof(index_line)) != 0;
+                        drawn[ly] = true;
+                        if (changed)
+                            memcpy(row, index_line, sizeof(index_line));
+                        if (color_on && (memcmp(line_palettes[ly], machine->BG_COLOR, 64) != 0 ||
+                                         memcmp(line_palettes[ly] + 64, machine->OBJ_COLOR, 64) != 0)) {
+                            memcpy(line_palettes[ly], machine->BG_COLOR, 64);
+                            memcpy(line_palettes[ly] + 64, machine->OBJ_COLOR, 64);
+                            changed = true;
+                        }
+                        if (changed) {
+                            dirty[ly] = true;
+                            stale[ly] = true;
+                        }
+                    }
 
                     // update STAT
-                    stat = cpu->read(0xff41);
-                    stat &= 0xfc;
-                    stat |= 0;
-                    cpu->overrideSTAT(stat);
-                    if (stat & 0x08)
+                    lcd->stat = cpu->read(0xff41);
+                    lcd->stat &= 0xfc;
+                    lcd->stat |= 0;
+                    cpu->overrideSTAT(lcd->stat);
+                    if (lcd->stat & 0x08)
                             cpu->write(0xff0f, cpu->read(0xff0f) | 0x02);
 
                     // free VRAM, OAM
@@ -416,15 +475,6 @@ void PPU::dot(int t_cycle_backlog) {
     }
 }
 
-void PPU::renderFrame() {
-    SDL_RenderClear(renderer);
-    SDL_UpdateTexture(texture, NULL, surface->pixels, surface->pitch);
-    SDL_RenderCopy(renderer, texture, NULL, NULL);
-    SDL_RenderPresent(renderer);
-
-    frame_ready = false;
-}
-
 int PPU::getMode() {
-    return mode;
+    return lcd->mode;
 }
\ No newline at end of file
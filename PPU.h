@@ -1,65 +1,81 @@
 #ifndef PPU_H
 #define PPU_H
 
-#include "SDL.h"
 #include "CPU.h"
+#include "Palette.h"
 #include <string.h>
 #include <iostream>
 
-#define WIDTH 160*4
-#define HEIGHT 144*4
-#define FRAMES_PER_SEC 60.0
 #define DOTS_PER_FRAME 70224
+// a little under 60, 59.7275
+#define FRAMES_PER_SEC (4194304.0 / DOTS_PER_FRAME)
 
 using namespace std;
 
-struct sprite {
-    uint8_t y_pos;
-    uint8_t x_pos;
-    uint8_t tile_ID;
-    uint8_t flags;
+// What the PPU puts out, in one block of anonymous memory so that a PPU
+// that never draws (a fork nobody looks at) doesn't cost any of it.
+struct PPUFrames {
+    uint8_t index_frame[160*144];
+    uint8_t line_palettes[144][128];
+    uint8_t gray_frame[160*144];
+    uint32_t framebuffer[160*144];
 };
 
 class PPU {
 public:
     PPU();
     ~PPU();
-    SDL_Window* window = NULL;
-    SDL_Renderer* renderer = NULL;
-    SDL_Surface* surface = NULL;
-    SDL_Texture* texture = NULL;
+    // finished pixels as color indices, 160x144. On the DMG they're the
+    // shade (0-3), on the CGB 0-31 is a BG palette color, 32-63 an OBJ
+    // palette color and 64 white (LCD off). The CGB palette RAM each line
+    // was drawn with is kept too, BG then OBJ, since games change it
+    // between lines.
+    uint8_t *index_frame;
+    uint8_t (*line_palettes)[128];
+    // 160x144 luma in gray mode (the index frame is then left alone)
+    uint8_t *gray_frame;
+    bool gray = false;
+    // lines of the picture that changed since the caller last cleared them
+    bool dirty[144] = {};
+    // the index frame turned into ARGB, only redoing lines that changed
+    uint32_t const *getFramebuffer();
+    void setPalette(int palette);
+    // how CGB colors come out, see Palette.h
+    void setColorProfile(int profile);
     void dot(int t_cycle_backlog);
     void init(CPU *cpu);
-    void close();
-    void renderFrame();
+    void mapState();
 
     bool frame_ready = false;
+    bool render = true;
     bool color_on = true;
     bool color_on_colorless = false;
     int getMode();
 
 private:
-    void set_pixel(SDL_Surface *surface, int x, int y, Uint32 pixel);
     void find_and_set_pixel(int x, int y);
     int getWindowColorID(int x, int y);
     int getBackgroundColorID(int x, int y);
     CPU *cpu;
+    uint8_t index_line[160];
+    uint32_t line[160];
 
-    uint8_t lcdc;
-    uint8_t ly = 0, lyc, stat;
-    uint8_t scx, scy;
-    int wy, wx;
-    int obj_h = 8;
-    bool bg_priority = false;
+    PPUFrames *frames;
+    uint32_t *framebuffer;
+    // lines of framebuffer that are behind index_frame
+    bool stale[144] = {};
+    bool drawn[144] = {};
+    // ARGB for the CGB palette snapshot cached_palette, plus white
+    uint8_t cached_palette[128];
+    uint32_t cgb_colors[65];
+    bool cgb_colors_valid = false;
+    int color_profile = COLOR_RAW;
+    uint32_t const *lineColors(int y);
 
-    void recomputeMapping(int target);
-    int bgp_mapping[4] = {};
-    int obp0_mapping[4] = {};
-    int obp1_mapping[4] = {};
+    PPUState *lcd = NULL;
+    MachineState *machine = NULL;
 
-    int mode = 0;
-    int scanline_dot = 0;
-    int curX = 0;
+    void recomputeMapping(int target);
 
     static int const num_palettes = 11;
     uint32_t const palettes[num_palettes][4] = {
@@ -78,13 +94,8 @@ private:
     uint32_t colors[4];
     void selectPalette(int palette);
 
-    struct sprite obj_on_line[10] = {};
-    int cur_obj = 0;
     void writeObjLine(struct sprite obj);
     void prepObjLine();
-    int scanline_objs_colors[160] = {};
-    int obj_colors_earliest_x[160] = {};
-    bool obj_priority[160] = {};
 };
 
 #endif
\ No newline at end of file
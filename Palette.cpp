@@ -0,0 +1,124 @@
+#include "Palette.h"
+#include <math.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PALETTE_X86
+#endif
+
+static uint32_t argb(int R, int G, int B) {
+    return 0xff000000 | (R << 16) | (G << 8) | B;
+}
+
+static uint32_t convert(uint16_t color, int profile) {
+    int r = color & 0x1f;
+    int g = (color >> 5) & 0x1f;
+    int b = (color >> 10) & 0x1f;
+
+    if (profile == COLOR_GBC_LCD) {
+        // each channel bleeds a bit into the others, and full white
+        // comes out slightly gray
+        int R = r * 26 + g * 4 + b * 2;
+        int G = g * 24 + b * 8;
+        int B = r * 6 + g * 4 + b * 22;
+        return argb((R < 960 ? R : 960) >> 2, (G < 960 ? G : 960) >> 2, (B < 960 ? B : 960) >> 2);
+    }
+    if (profile == COLOR_GAMMA) {
+        // the same mixing done on light levels: the LCD's gamma is about
+        // 4, a monitor's 2.2
+        double lr = pow(r / 31.0, 4.0);
+        double lg = pow(g / 31.0, 4.0);
+        double lb = pow(b / 31.0, 4.0);
+        double scale = 255.0 * 255.0 / 280.0;
+        int R = (int)(pow((255 * lr + 50 * lg +   0 * lb) / 255.0, 1 / 2.2) * scale + 0.5);
+        int G = (int)(pow(( 10 * lr + 230 * lg + 30 * lb) / 255.0, 1 / 2.2) * scale + 0.5);
+        int B = (int)(pow(( 50 * lr + 10 * lg + 220 * lb) / 255.0, 1 / 2.2) * scale + 0.5);
+        return argb(R, G, B);
+    }
+    return argb(r << 3, g << 3, b << 3);
+}
+
+uint32_t const *Palette::table(int profile) {
+    // 128 KB each; static locals are built once even with several threads
+    // asking at the same time
+    static std::vector<uint32_t> const tables = [] {
+        std::vector<uint32_t> all(NUM_COLOR_PROFILES * 32768);
+        for (int p=0; p<NUM_COLOR_PROFILES; p++)
+            for (int c=0; c<32768; c++)
+                all[p * 32768 + c] = convert(c, p);
+        return all;
+    }();
+    if (profile < 0 || profile >= NUM_COLOR_PROFILES)
+        profile = COLOR_RAW;
+    return tables.data() + profile * 32768;
+}
+
+uint32_t Palette::fromRGB555(uint16_t color, int profile) {
+    return table(profile)[color & 0x7fff];
+}
+
+static void resolveScalar(uint8_t const *indices, uint32_t const *colors,
+                          uint32_t *out, int from, int n) {
+    for (int i=from; i<n; i++)
+        out[i] = colors[indices[i]];
+}
+
+#ifdef PALETTE_X86
+// Four colors (DMG shades) don't need a lookup at all: each output lane
+// picks its color with compare masks, 16 pixels at a time.
+static void resolveShadesSSE2(uint8_t const *indices, uint32_t const *colors,
+                              uint32_t *out, int n) {
+    __m128i const zero = _mm_setzero_si128();
+    __m128i shade[4], color[4];
+    for (int k=0; k<4; k++) {
+        shade[k] = _mm_set1_epi32(k);
+        color[k] = _mm_set1_epi32((int)colors[k]);
+    }
+
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128((__m128i const*)(indices + i));
+        __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        __m128i lanes[4] = {
+            _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+            _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)
+        };
+        for (int j=0; j<4; j++) {
+            __m128i pixel = zero;
+            for (int k=0; k<4; k++)
+                pixel = _mm_or_si128(pixel, _mm_and_si128(_mm_cmpeq_epi32(lanes[j], shade[k]), color[k]));
+            _mm_storeu_si128((__m128i*)(out + i + 4*j), pixel);
+        }
+    }
+    resolveScalar(indices, colors, out, i, n);
+}
+
+__attribute__((target("avx2")))
+static void resolveAVX2(uint8_t const *indices, uint32_t const *colors,
+                        uint32_t *out, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i bytes = _mm_loadl_epi64((__m128i const*)(indices + i));
+        __m256i lanes = _mm256_cvtepu8_epi32(bytes);
+        __m256i pixels = _mm256_i32gather_epi32((int const*)colors, lanes, 4);
+        _mm256_storeu_si256((__m256i*)(out + i), pixels);
+    }
+    resolveScalar(indices, colors, out, i, n);
+}
+#endif
+
+void Palette::resolve(uint8_t const *indices, uint32_t const *colors, int num_colors,
+                      uint32_t *out, int n) {
+#ifdef PALETTE_X86
+    static bool const has_avx2 = __builtin_cpu_supports("avx2");
+    if (num_colors <= 4)
+        resolveShadesSSE2(indices, colors, out, n);
+    else if (has_avx2)
+        resolveAVX2(indices, colors, out, n);
+    else
+        resolveScalar(indices, colors, out, 0, n);
+#else
+    resolveScalar(indices, colors, out, 0, n);
+#endif
+}
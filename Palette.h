@@ -0,0 +1,32 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdint.h>
+
+// How Game Boy Color colors are turned into ARGB. Raw just scales each 5
+// bit channel up; the GBC's LCD is much less saturated and brighter than
+// that, which the other two imitate (the gamma one more closely, with the
+// LCD's response curve worked in).
+#define COLOR_RAW     0
+#define COLOR_GBC_LCD 1
+#define COLOR_GAMMA   2
+#define NUM_COLOR_PROFILES 3
+
+// Turning what the PPU draws (color indices) into ARGB pixels. The PPU
+// only keeps indices, so this runs when somebody actually wants the
+// picture, and changing the colors doesn't need the game to run again.
+class Palette {
+public:
+    // a Game Boy Color palette RAM entry, 5 bits each of red, green and
+    // blue, little end first
+    static uint32_t fromRGB555(uint16_t color, int profile = COLOR_RAW);
+    // all 32768 colors for a profile, worked out the first time it's asked
+    // for
+    static uint32_t const *table(int profile);
+
+    // out[i] = colors[indices[i]] for n pixels
+    static void resolve(uint8_t const *indices, uint32_t const *colors, int num_colors,
+                        uint32_t *out, int n);
+};
+
+#endif
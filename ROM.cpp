@@ -1,201 +1,165 @@
 #include "ROM.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 ROM::ROM(bool color_on) {
-    string name;
-    if (color_on)
-        name = cgb_boot_name;
-    else
-        name = dmg_boot_name;
-
-    // read boot rom
-    ifstream f(name, ios::in|ios::binary|ios::ate);
-    if (!f.good()) {
-        cout << "Couldn't read '" << cgb_boot_name << "'!" << endl;
-    }
-
-    // file size
-    int fsize = f.tellg();
-    f.seekg(ios::beg);
-    printf("Boot ROM size: %04X\n", fsize);
-
-    boot_rom = (uint8_t*)malloc(fsize * sizeof(uint8_t));
-    f.read((char*)boot_rom, fsize);
-    f.close();
+    this->color_on = color_on;
 }
 
 ROM::~ROM() {
-    saveFile();
-
-    if (ROM_data != NULL) {
-        free(ROM_data);
+    if (flush_thread.joinable()) {
+        {
+            lock_guard<mutex> guard(flush_lock);
+            flush_quit = true;
+        }
+        flush_wake.notify_one();
+        flush_thread.join();
     }
 
+    saveFile();
+
     if (RAM_data != NULL) {
-        free(RAM_data);
+        munmap(RAM_data, RAM_size);
     }
 }
 
 int ROM::load(string file) {
-    file_name = file;
-    if (file.find('/') == file.npos && file.find('\\') == file.npos) {
-        file_path = "";
-        file_raw_name = file;
-    } else {
-        file_path = file.substr(0, file.find_last_of("/\\"));
-        file_raw_name = file.substr(file.find_last_of("/\\")+1);
-    }
+    return load(CartridgeImage::open(file, color_on));
+}
 
-    // read file
-    ifstream f(file, ios::in|ios::binary|ios::ate);
-    if (!f.good()) {
-        cout << "Couldn't read '" << file << "'!" << endl;
+int ROM::load(shared_ptr<CartridgeImage> image) {
+    if (!image)
         return 1;
-    }
 
-    // file size
-    int fsize = f.tellg();
-    f.seekg(ios::beg);
+    this->image = image;
+    MBC1 = image->MBC1;
+    MBC3 = image->MBC3;
+    MBC5 = image->MBC5;
+    RAM_size = image->RAM_size;
+    ROM_size = image->ROM_size;
+    num_RAM_banks = image->num_RAM_banks;
 
-    ROM_data = (uint8_t*)malloc(fsize * sizeof(uint8_t));
-    if (ROM_data == NULL) {
-        cout << "Out of memory! File is too big." << endl;
-        return 1;
-    }
+    if (RAM_size == 0)
+        return 0;
 
-    f.read((char*)ROM_data, fsize);
-    f.close();
-
-    cout << "File read, file size " << fsize << "." << endl;
-
-    nintendo_logo =        ROM_data + 0x0104;
-    title =                ROM_data + 0x0134;
-    manu_code =            ROM_data + 0x013F;
-    CGB_flag =             ROM_data + 0x0143;
-    new_licensee_code =    ROM_data + 0x0144;
-    SGB_flag =             ROM_data + 0x0146;
-    cart_type =            ROM_data + 0x0147;
-    ROM_size_info =        ROM_data + 0x0148;
-    RAM_size_info =        ROM_data + 0x0149;
-    dest_code =            ROM_data + 0x014A;
-    old_licensee_code =    ROM_data + 0x014B;
-    mask_ROM_v =           ROM_data + 0x014C;
-    header_checksum =      ROM_data + 0x014D;
-    global_checksum =      ROM_data + 0x014E;
-
-    if (*ROM_size_info <= 0x08) {
-        ROM_size = 0x8000 * (1 << *ROM_size_info);
-        num_ROM_banks = (1 << *ROM_size_info) * 2;
-    }
-    else {
-        cout << "Unsupported ROM size." << endl;
-        return 1;
+    if (save_file && !image->file_name.empty() && mapSaveFile(image->file_path + "/saves/" + image->file_raw_name + ".extram") == 0) {
+        if (save_interval_ms > 0)
+            flush_thread = thread(&ROM::flusher, this);
+        return 0;
     }
 
-    switch (*RAM_size_info) {
-        case 0x00: RAM_size = 0;
-        case 0x01: break;
-        case 0x02: RAM_size = 0x2000; break;
-        case 0x03: RAM_size = 0x8000; break;
-        case 0x04: RAM_size = 0x20000; break;
-        case 0x05: RAM_size = 0x10000; break;
-    }
-    num_RAM_banks = RAM_size / 0x2000;
-
-    RAM_data = (uint8_t*)calloc(RAM_size, sizeof(uint8_t));
+    // no saves folder, run from memory only
+    void *data = mmap(NULL, RAM_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    RAM_data = data == MAP_FAILED ? NULL : (uint8_t*)data;
     if (RAM_data == NULL) {
         cout << "Out of memory! Not enough space for RAM." << endl;
         return 1;
     }
 
-    ifstream saved_ram(file_path + "/saves/" + file_raw_name + ".extram", ios::in|ios::binary|ios::ate);
-    if (saved_ram.good()) {
-        fsize = saved_ram.tellg();
-        saved_ram.seekg(ios::beg);
+    return 0;
+}
 
-        if (fsize == RAM_size) {
-            saved_ram.read((char*)RAM_data, RAM_size);
-            printf("External RAM loaded\n");
+int ROM::mapSaveFile(string name) {
+    int fd = open(name.c_str(), O_RDWR);
+    if (fd >= 0) {
+        // Saves from other emulators can be longer (MBC3 ones often have
+        // the clock on the end), so only the start gets used and the rest
+        // is left as it is. One that's too short can't be ours, so it's
+        // moved out of the way instead of being written over.
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < RAM_size) {
+            ::close(fd);
+            if (rename(name.c_str(), (name + ".bak").c_str()) != 0) {
+                printf("Save file %s is too small and couldn't be moved, not using it\n", name.c_str());
+                return 1;
+            }
+            printf("Save file %s is too small, moved it to %s.bak\n", name.c_str(), name.c_str());
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        fd = open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+            return 1;
+        if (ftruncate(fd, RAM_size) != 0) {
+            ::close(fd);
+            return 1;
         }
     }
 
-    if (*cart_type >= 0x1 && *cart_type <= 0x3)
-        MBC1 = true;
-    else if (*cart_type >= 0x0F && *cart_type <= 0x13)
-        MBC3 = true;
-    else if (*cart_type >= 0x19 && *cart_type <= 0x1E)
-        MBC5 = true;
+    void *data = mmap(NULL, RAM_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return 1;
 
+    RAM_data = (uint8_t*)data;
+    RAM_file = true;
     return 0;
 }
 
-void ROM::printROMinfo() {
-    for (uint8_t r=0; r<3; r++) { for (uint8_t i=0; i<16; i++) 
-        {
-            printf("%02X ", *(nintendo_logo+16*r+i));
-        }
+void ROM::setSaveInterval(int ms) {
+    save_interval_ms = ms;
+}
 
-        printf("\n");
-    }
+void ROM::setSaveFile(bool enabled) {
+    save_file = enabled;
+}
 
-    for (int i=0; i<16 && *(title+i) != 0x00; i++) {
-        printf("%c", *(title+i));
+void ROM::flusher() {
+    unique_lock<mutex> guard(flush_lock);
+    while (!flush_quit) {
+        flush_wake.wait_for(guard, chrono::milliseconds(save_interval_ms));
+        saveFile();
     }
-    printf("\n");
-
-    printf("%c%c%c%c\n", *(manu_code), *(manu_code+1), *(manu_code+2), *(manu_code+3));
-    printf("%02X\n", *(CGB_flag));
-    printf("%c%c\n", *(new_licensee_code), *(new_licensee_code+1));
-    printf("%02X\n", *(SGB_flag));
-    printf("%02X = ", *(cart_type)); cout << cartridge_types[*cart_type] << endl;
-    printf("%02X = %d bits of ROM, %d banks\n", *(ROM_size_info), ROM_size, num_ROM_banks);
-    printf("%02X = %d bits of RAM, %d banks\n", *(RAM_size_info), RAM_size, num_RAM_banks);
-
-    if (*dest_code == 0x00)
-        cout << "Destination: Japan" << endl;
-    else
-        cout << "Destination: Overseas only" << endl;
-
-    printf("%02X\n", *(old_licensee_code));
-    printf("%02X\n", *(mask_ROM_v));
-    printf("%02X\n", *(header_checksum));
-    printf("%02X\n", *(global_checksum));
+}
 
-    printf("%p %p\n", ROM_data, RAM_data);
+void ROM::printROMinfo() {
+    image->printROMinfo();
+    printf("%p\n", RAM_data);
 }
 
+// Writes land in the page cache as soon as the game makes them, so a killed
+// process loses nothing; this pushes the dirty banks out to the disk.
 void ROM::saveFile() {
-    std::ofstream out(file_path + "/saves/" + file_raw_name + ".extram", std::ofstream::binary);
+    if (!RAM_file)
+        return;
 
-    if (RAM_data != NULL) {
-        out.write((char*)RAM_data, RAM_size);
-        printf("External RAM saved\n");
+    uint32_t dirty = dirty_banks.exchange(0);
+    if (dirty == 0)
+        return;
+
+    for (uint32_t bank=0; bank<num_RAM_banks; bank++) {
+        if (dirty & (1u << bank))
+            msync(RAM_data + bank * 0x2000, 0x2000, MS_SYNC);
     }
+}
 
-    out.close();
+uint8_t const *ROM::getROMbank(uint32_t bank_id) {
+    return image->getROMbank(bank_id);
 }
 
-uint8_t *ROM::getROMbank(int bank_id) {
-    if (bank_id >= num_ROM_banks) {
-        cout << "Tried accessing non-existent ROM bank!" << endl;
+// NULL for a bank the cartridge doesn't have.
+uint8_t *ROM::getRAMbank(uint32_t bank_id) {
+    if (bank_id >= num_RAM_banks)
         return NULL;
-    }
 
-    return (ROM_data + bank_id * 0x4000);
+    return (RAM_data + bank_id * 0x2000);
 }
 
-uint8_t *ROM::getRAMbank(int bank_id) {
-    if (bank_id >= num_RAM_banks) {
-        cout << "Tried accessing non-existent RAM bank!" << endl;
-        return NULL;
-    }
+uint8_t *ROM::getRAM() {
+    return RAM_data;
+}
 
-    return (RAM_data + bank_id * 0x2000);
+void ROM::markAllDirty() {
+    dirty_banks.store((1u << num_RAM_banks) - 1);
 }
 
 bool ROM::isCGBGame() {
-    return *CGB_flag == 0x80 || *CGB_flag == 0xC0;
+    return image->isCGBGame();
 }
 
 uint8_t ROM::readBoot(uint16_t mem_address) {
-    return *(boot_rom + mem_address);
-}
\ No newline at end of file
+    return image->readBoot(mem_address);
+}
@@ -4,10 +4,17 @@
 #include <string.h>
 #include <fstream>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "CartridgeImage.h"
 
 using namespace std;
 
+// Per-instance cartridge state. The ROM contents themselves live in a
+// shared CartridgeImage; only the external RAM is owned here.
 class ROM {
 public:
     ROM(bool color_on);
@@ -15,16 +22,27 @@ public:
 
     void init();
     int load(string file);
+    int load(shared_ptr<CartridgeImage> image);
     void saveFile();
-    string file_name;
-    string file_path;
-    string file_raw_name;
+    void setSaveInterval(int ms);
+    void setSaveFile(bool enabled);
+
+    shared_ptr<CartridgeImage> image;
 
     void setDebug();
     void printROMinfo();
     
-    uint8_t *getROMbank(int bank_id);
-    uint8_t *getRAMbank(int bank_id);
+    uint8_t const *getROMbank(uint32_t bank_id);
+    uint8_t *getRAMbank(uint32_t bank_id);
+    uint8_t *getRAM();
+    void markAllDirty();
+
+    // called on every external RAM write, so keep it to a load and a test
+    inline void markDirty(uint8_t const *address) {
+        uint32_t bit = 1u << ((address - RAM_data) >> 13);
+        if (!(dirty_banks.load(memory_order_relaxed) & bit))
+            dirty_banks.fetch_or(bit, memory_order_relaxed);
+    }
 
     uint8_t readBoot(uint16_t mem_address);
 
@@ -39,63 +57,24 @@ public:
     
 private:
     bool debug = false;
+    bool color_on = false;
 
-    uint8_t *ROM_data = NULL;
     uint8_t *RAM_data = NULL;
-
-    uint8_t *nintendo_logo = NULL;
-    uint8_t *title = NULL;
-    uint8_t *manu_code = NULL;
-    uint8_t *CGB_flag = NULL;
-    uint8_t *new_licensee_code = NULL;
-    uint8_t *SGB_flag = NULL;
-    uint8_t *cart_type = NULL;
-
-    uint8_t *ROM_size_info = NULL;
-    uint32_t num_ROM_banks = 0;
-    uint8_t *RAM_size_info = NULL;
     uint32_t num_RAM_banks = 0;
 
-    uint8_t *dest_code = NULL;
-    uint8_t *old_licensee_code = NULL;
-    uint8_t *mask_ROM_v = NULL;
-    uint8_t *header_checksum = NULL;
-    uint8_t *global_checksum = NULL;
-
-    string const dmg_boot_name = "../boot_roms/dmg_boot.bin";
-    string const cgb_boot_name = "../boot_roms/cgb_boot.bin";
-    uint8_t *boot_rom = NULL;
-
-    map<int, string> cartridge_types{
-        {0x00, "ROM ONLY"},
-        {0x01, "MBC1"},
-        {0x02, "MBC1+RAM"},
-        {0x03, "MBC1+RAM+BATTERY"},
-        {0x05, "MBC2"},
-        {0x06, "MBC2+BATTERY"},
-        {0x08, "ROM+RAM"},
-        {0x09, "ROM+RAM+BATTERY"},
-        {0x0B, "MMM01"},
-        {0x0C, "MMM01+RAM"},
-        {0x0D, "MMM01+RAM+BATTERY"},
-        {0x0F, "MBC3+TIMER+BATTERY"},
-        {0x10, "MBC3+TIMER+RAM+BATTERY"},
-        {0x11, "MBC3"},
-        {0x12, "MBC3+RAM"},
-        {0x13, "MBC3+RAM+BATTERY"},
-        {0x19, "MBC5"},
-        {0x1A, "MBC5+RAM"},
-        {0x1B, "MBC5+RAM+BATTERY"},
-        {0x1C, "MBC5+RUMBLE"},
-        {0x1D, "MBC5+RUMBLE+RAM"},
-        {0x1E, "MBC5+RUMBLE+RAM+BATTERY"},
-        {0x20, "MBC6"},
-        {0x22, "MBC7+SENSOR+RUMBLE+RAM+BATTERY"},
-        {0xFC, "POCKET CAMERA"},
-        {0xFD, "BANDAI TAMA5"},
-        {0xFE, "HuC3"},
-        {0xFF, "HuC1+RAM+BATTERY"}
-    };
+    // battery save, the .extram file is mapped as the backing store of
+    // RAM_data and dirty banks are msync'd by a background thread
+    bool save_file = true;
+    bool RAM_file = false;
+    int save_interval_ms = 1000;
+    atomic<uint32_t> dirty_banks{0};
+    int mapSaveFile(string name);
+    void flusher();
+
+    thread flush_thread;
+    mutex flush_lock;
+    condition_variable flush_wake;
+    bool flush_quit = false;
 };
 
-#endif
\ No newline at end of file
+#endif
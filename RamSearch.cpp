@@ -0,0 +1,171 @@
+#include "RamSearch.h"
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEARCH_X86
+#endif
+
+// WRAM banks, then HRAM, then external RAM banks
+#define HRAM_SIZE 0x7f
+
+RamSearch::RamSearch(CPU *cpu) {
+    this->cpu = cpu;
+    num_WRAM_banks = cpu->color_on ? 8 : 2;
+    num_EXT_banks = cpu->cartridge->RAM_size / 0x2000;
+
+    size_t size = num_WRAM_banks * 0x1000 + HRAM_SIZE + num_EXT_banks * 0x2000;
+    previous.resize(size);
+    current.resize(size);
+    mask.resize(size);
+    reset();
+}
+
+void RamSearch::capture(vector<uint8_t> &to) {
+    uint8_t *out = to.data();
+    for (int i=0; i<num_WRAM_banks; i++, out += 0x1000)
+        memcpy(out, cpu->getBank(WRAM_BANK_ID + i), 0x1000);
+    memcpy(out, cpu->view(0xff80), HRAM_SIZE);
+    out += HRAM_SIZE;
+    for (int i=0; i<num_EXT_banks; i++, out += 0x2000)
+        memcpy(out, cpu->getBank(EXT_BANK_ID + i), 0x2000);
+}
+
+void RamSearch::reset() {
+    capture(previous);
+    current = previous;
+    memset(mask.data(), 0xff, mask.size());
+    count = mask.size();
+}
+
+size_t RamSearch::candidates() {
+    return count;
+}
+
+// Keeps mask[i] only where (a[i] op b[i]) holds. b is either the previous
+// snapshot or NULL for comparing against value. Returns the new count.
+static size_t filterScalar(uint8_t const *a, uint8_t const *b, uint8_t value, int op,
+                           uint8_t *mask, size_t begin, size_t n) {
+    size_t count = 0;
+    for (size_t i=begin; i<n; i++) {
+        uint8_t x = a[i], y = b ? b[i] : value;
+        bool keep = false;
+        switch (op) {
+            case SEARCH_EQUAL:
+            case SEARCH_UNCHANGED: keep = x == y; break;
+            case SEARCH_NOT_EQUAL:
+            case SEARCH_CHANGED: keep = x != y; break;
+            case SEARCH_GREATER:
+            case SEARCH_INCREASED: keep = x > y; break;
+            case SEARCH_LESS:
+            case SEARCH_DECREASED: keep = x < y; break;
+        }
+        if (!keep)
+            mask[i] = 0;
+        count += mask[i] != 0;
+    }
+    return count;
+}
+
+#ifdef SEARCH_X86
+static size_t filterSSE2(uint8_t const *a, uint8_t const *b, uint8_t value, int op,
+                         uint8_t *mask, size_t n) {
+    // unsigned compares are signed compares with the top bit flipped
+    __m128i const flip = _mm_set1_epi8((char)0x80);
+    __m128i const fixed = _mm_set1_epi8((char)value);
+    size_t count = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((__m128i const*)(a + i));
+        __m128i y = b ? _mm_loadu_si128((__m128i const*)(b + i)) : fixed;
+        __m128i keep;
+        switch (op) {
+            case SEARCH_EQUAL:
+            case SEARCH_UNCHANGED: keep = _mm_cmpeq_epi8(x, y); break;
+            case SEARCH_NOT_EQUAL:
+            case SEARCH_CHANGED: keep = _mm_andnot_si128(_mm_cmpeq_epi8(x, y), _mm_set1_epi8(-1)); break;
+            case SEARCH_GREATER:
+            case SEARCH_INCREASED: keep = _mm_cmpgt_epi8(_mm_xor_si128(x, flip), _mm_xor_si128(y, flip)); break;
+            default: keep = _mm_cmplt_epi8(_mm_xor_si128(x, flip), _mm_xor_si128(y, flip)); break;
+        }
+        __m128i m = _mm_and_si128(_mm_loadu_si128((__m128i const*)(mask + i)), keep);
+        _mm_storeu_si128((__m128i*)(mask + i), m);
+        count += __builtin_popcount(_mm_movemask_epi8(m));
+    }
+    return count + filterScalar(a, b, value, op, mask, i, n);
+}
+
+__attribute__((target("avx2")))
+static size_t filterAVX2(uint8_t const *a, uint8_t const *b, uint8_t value, int op,
+                         uint8_t *mask, size_t n) {
+    __m256i const flip = _mm256_set1_epi8((char)0x80);
+    __m256i const fixed = _mm256_set1_epi8((char)value);
+    size_t count = 0, i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((__m256i const*)(a + i));
+        __m256i y = b ? _mm256_loadu_si256((__m256i const*)(b + i)) : fixed;
+        __m256i keep;
+        switch (op) {
+            case SEARCH_EQUAL:
+            case SEARCH_UNCHANGED: keep = _mm256_cmpeq_epi8(x, y); break;
+            case SEARCH_NOT_EQUAL:
+            case SEARCH_CHANGED: keep = _mm256_andnot_si256(_mm256_cmpeq_epi8(x, y), _mm256_set1_epi8(-1)); break;
+            case SEARCH_GREATER:
+            case SEARCH_INCREASED: keep = _mm256_cmpgt_epi8(_mm256_xor_si256(x, flip), _mm256_xor_si256(y, flip)); break;
+            default: keep = _mm256_cmpgt_epi8(_mm256_xor_si256(y, flip), _mm256_xor_si256(x, flip)); break;
+        }
+        __m256i m = _mm256_and_si256(_mm256_loadu_si256((__m256i const*)(mask + i)), keep);
+        _mm256_storeu_si256((__m256i*)(mask + i), m);
+        count += __builtin_popcount((uint32_t)_mm256_movemask_epi8(m));
+    }
+    return count + filterScalar(a, b, value, op, mask, i, n);
+}
+#endif
+
+size_t RamSearch::filter(int op, uint8_t value) {
+    capture(current);
+    bool against_previous = op >= SEARCH_CHANGED;
+    uint8_t const *b = against_previous ? previous.data() : NULL;
+
+#ifdef SEARCH_X86
+    static bool const has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2)
+        count = filterAVX2(current.data(), b, value, op, mask.data(), mask.size());
+    else
+        count = filterSSE2(current.data(), b, value, op, mask.data(), mask.size());
+#else
+    count = filterScalar(current.data(), b, value, op, mask.data(), 0, mask.size());
+#endif
+
+    previous.swap(current);
+    return count;
+}
+
+RamSearch::Result RamSearch::locate(size_t index) {
+    Result r;
+    r.value = previous[index];
+    r.previous = current[index];
+
+    size_t wram = num_WRAM_banks * 0x1000;
+    if (index < wram) {
+        r.bank = index / 0x1000;
+        r.address = (r.bank == 0 ? 0xC000 : 0xD000) + index % 0x1000;
+    } else if (index < wram + HRAM_SIZE) {
+        r.bank = 0;
+        r.address = 0xFF80 + index - wram;
+    } else {
+        index -= wram + HRAM_SIZE;
+        r.bank = index / 0x2000;
+        r.address = 0xA000 + index % 0x2000;
+    }
+    return r;
+}
+
+// After a filter previous holds the newest snapshot and current the one
+// before it.
+vector<RamSearch::Result> RamSearch::results(size_t max) {
+    vector<Result> found;
+    for (size_t i=0; i<mask.size() && found.size()<max; i++) {
+        if (mask[i])
+            found.push_back(locate(i));
+    }
+    return found;
+}
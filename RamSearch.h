@@ -0,0 +1,55 @@
+#ifndef RAM_SEARCH_H
+#define RAM_SEARCH_H
+
+#include <stdint.h>
+#include <vector>
+#include "CPU.h"
+
+using namespace std;
+
+#define SEARCH_EQUAL 0
+#define SEARCH_NOT_EQUAL 1
+#define SEARCH_GREATER 2
+#define SEARCH_LESS 3
+#define SEARCH_CHANGED 4
+#define SEARCH_UNCHANGED 5
+#define SEARCH_INCREASED 6
+#define SEARCH_DECREASED 7
+
+// Cheat finder. Starts out with every byte of WRAM, HRAM and external RAM
+// as a candidate, and each filter() keeps the ones that compare the right
+// way against a value or against what they were at the last filter. All
+// the regions are laid out in one flat buffer so the compares run over it
+// 16 or 32 bytes at a time (SSE2, or AVX2 where the CPU has it).
+class RamSearch {
+public:
+    RamSearch(CPU *cpu);
+
+    struct Result {
+        uint16_t address;
+        int bank;
+        uint8_t value;
+        uint8_t previous;
+    };
+
+    void reset();
+    // returns how many candidates are left
+    size_t filter(int op, uint8_t value = 0);
+    size_t candidates();
+    vector<Result> results(size_t max);
+
+private:
+    CPU *cpu;
+    int num_WRAM_banks;
+    int num_EXT_banks;
+
+    vector<uint8_t> previous;
+    vector<uint8_t> current;
+    vector<uint8_t> mask;   // 0xff for a candidate
+    size_t count = 0;
+
+    void capture(vector<uint8_t> &to);
+    Result locate(size_t index);
+};
+
+#endif
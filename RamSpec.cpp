@@ -0,0 +1,59 @@
+#include "RamSpec.h"
+#include <string.h>
+
+// Which stretch of the memory map an address is in; a field can't span two
+// of them since they're backed by different memory.
+int RamSpec::region(uint16_t address) {
+    static uint32_t const ends[] = {0x4000, 0x8000, 0xA000, 0xC000, 0xD000, 0xE000,
+                                    0xF000, 0xFE00, 0xFEA0, 0xFF00, 0xFF80, 0xFFFF, 0x10000};
+    int i = 0;
+    while (address >= ends[i])
+        i++;
+    return i;
+}
+
+int RamSpec::add(uint16_t address, int type, int count, int bank) {
+    int length = count * (type == FIELD_U16LE ? 2 : 1);
+    if (count < 1 || (type == FIELD_BCD && count > 4) ||
+        address + length > 0x10000 || region(address) != region(address + length - 1)) {
+        cout << "Bad RAM field at " << hex << address << dec << endl;
+        return -1;
+    }
+
+    Field field;
+    field.address = address;
+    field.type = type;
+    field.count = count;
+    field.bank = bank;
+    fields.push_back(field);
+
+    int offset = bytes;
+    bytes += type == FIELD_BCD ? 4 : length;
+    return offset;
+}
+
+size_t RamSpec::size() const {
+    return bytes;
+}
+
+void RamSpec::gather(CPU *cpu, uint8_t *out) const {
+    for (Field const &field : fields) {
+        uint8_t const *src = cpu->view(field.address, field.bank);
+        int length = field.count * (field.type == FIELD_U16LE ? 2 : 1);
+
+        if (field.type == FIELD_BCD) {
+            uint32_t value = 0;
+            for (int i=0; src != NULL && i<field.count; i++)
+                value = value * 100 + (src[i] >> 4) * 10 + (src[i] & 0x0f);
+            memcpy(out, &value, 4);
+            out += 4;
+        } else {
+            // u16le is stored the way it's laid out in memory
+            if (src != NULL)
+                memcpy(out, src, length);
+            else
+                memset(out, 0xff, length);
+            out += length;
+        }
+    }
+}
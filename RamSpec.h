@@ -0,0 +1,41 @@
+#ifndef RAM_SPEC_H
+#define RAM_SPEC_H
+
+#include <stdint.h>
+#include <vector>
+#include "CPU.h"
+
+using namespace std;
+
+#define FIELD_U8 0
+#define FIELD_U16LE 1
+#define FIELD_BCD 2
+
+// A list of game variables to read out of memory every step (HP, position,
+// score...). gather() packs them one after another with no padding: u8
+// fields take a byte per element, u16le fields two, and a BCD field is
+// `count` bytes of digits, most significant first, read out as one
+// uint32. Gathering costs one lookup per field, however big RAM is.
+class RamSpec {
+public:
+    // returns the field's byte offset in the gathered output, or -1 if the
+    // range isn't all in one memory region
+    int add(uint16_t address, int type, int count = 1, int bank = -1);
+
+    size_t size() const;
+    void gather(CPU *cpu, uint8_t *out) const;
+
+private:
+    struct Field {
+        uint16_t address;
+        int type;
+        int count;
+        int bank;
+    };
+    vector<Field> fields;
+    size_t bytes = 0;
+
+    static int region(uint16_t address);
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "Regression.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <dirent.h>
+#include <stdio.h>
+
+static bool endsWith(string const &s, string const &end) {
+    return s.size() >= end.size() && s.compare(s.size() - end.size(), end.size(), end) == 0;
+}
+
+int Regression::run(string dir, bool color_on, int frames) {
+    DIR *d = opendir(dir.c_str());
+    if (d == NULL) {
+        printf("Couldn't open %s\n", dir.c_str());
+        return 1;
+    }
+    vector<string> roms;
+    while (dirent *entry = readdir(d)) {
+        string name = entry->d_name;
+        if (endsWith(name, ".gb") || endsWith(name, ".gbc"))
+            roms.push_back(dir + "/" + name);
+    }
+    closedir(d);
+    sort(roms.begin(), roms.end());
+    if (roms.empty()) {
+        printf("No games in %s\n", dir.c_str());
+        return 1;
+    }
+
+    vector<Result> results(roms.size());
+    ThreadPool pool;
+    pool.run(roms.size(), [&](int i) {
+        // .gbc games always get a Game Boy Color
+        check(roms[i], color_on || endsWith(roms[i], ".gbc"), frames, &results[i]);
+    });
+
+    int failed = 0;
+    for (Result const &result : results) {
+        printf("%-5s %s: %s\n", result.passed ? "ok" : "FAIL", result.name.c_str(), result.message.c_str());
+        failed += !result.passed;
+    }
+    printf("%d of %zu games passed\n", (int)(roms.size() - failed), roms.size());
+    return failed > 0;
+}
+
+// golden files have a line per frame: picture hash, then state hash, and
+// end with how many frames there were so a cut off one doesn't pass
+void Regression::check(string rom, bool color_on, int frames, Result *result) {
+    result->name = rom.substr(rom.find_last_of('/') + 1);
+    result->passed = false;
+
+    Movie movie;
+    FILE *f = fopen((rom + ".movie").c_str(), "rb");
+    bool has_movie = f != NULL;
+    if (f != NULL)
+        fclose(f);
+    if (has_movie && movie.load(rom + ".movie")) {
+        result->message = "couldn't read the movie";
+        return;
+    }
+
+    vector<uint64_t> golden;
+    f = fopen((rom + ".golden").c_str(), "r");
+    bool has_golden = f != NULL;
+    if (f != NULL)
+        fclose(f);
+    if (has_golden && readGolden(rom + ".golden", &golden)) {
+        result->message = "the golden file is empty or cut short";
+        return;
+    }
+    int length = has_golden ? golden.size() / 2 : has_movie ? movie.length() : frames;
+    if (length <= 0) {
+        result->message = "the movie is empty";
+        return;
+    }
+
+    Emulator *emu = new Emulator(color_on);
+    emu->setSaveFile(false);
+    emu->setFixedClock(FIXED_CLOCK_START);
+    if (emu->start(rom)) {
+        delete emu;
+        result->message = "couldn't start the game";
+        return;
+    }
+
+    vector<uint64_t> hashes;
+    for (int i=0; i<length; i++) {
+        emu->setButtons(movie.buttons(i));
+        emu->runFrame(true);
+        uint64_t picture = emu->frameHash();
+        uint64_t state = emu->stateHash();
+        hashes.push_back(picture);
+        hashes.push_back(state);
+
+        if (has_golden && (picture != golden[2*i] || state != golden[2*i+1])) {
+            string image = rom + ".frame" + to_string(i) + ".ppm";
+            savePPM(image, emu->getFramebuffer());
+            result->message = "frame " + to_string(i) + " differs (" +
+                              (picture != golden[2*i] ? "picture" : "machine state only") +
+                              "), saved " + image.substr(image.find_last_of('/') + 1);
+            delete emu;
+            return;
+        }
+    }
+    delete emu;
+
+    if (has_golden) {
+        result->message = to_string(length) + " frames the same";
+    } else if (writeGolden(rom + ".golden", hashes) == 0) {
+        result->message = "no golden file yet, wrote " + to_string(length) + " frames";
+    } else {
+        result->message = "couldn't write the golden file";
+        return;
+    }
+    result->passed = true;
+}
+
+int Regression::readGolden(string file, vector<uint64_t> *hashes) {
+    FILE *f = fopen(file.c_str(), "r");
+    if (f == NULL)
+        return 1;
+
+    unsigned long long picture, state;
+    while (fscanf(f, "%llx %llx", &picture, &state) == 2) {
+        hashes->push_back(picture);
+        hashes->push_back(state);
+    }
+    int frames = -1;
+    bool ended = fscanf(f, " # %d frames", &frames) == 1;
+    fclose(f);
+    if (!ended || frames <= 0 || (size_t)frames != hashes->size() / 2)
+        return 1;
+    return 0;
+}
+
+int Regression::writeGolden(string file, vector<uint64_t> const &hashes) {
+    FILE *f = fopen(file.c_str(), "w");
+    if (f == NULL)
+        return 1;
+
+    for (size_t i=0; i+1<hashes.size(); i+=2)
+        fprintf(f, "%016llx %016llx\n", (unsigned long long)hashes[i], (unsigned long long)hashes[i+1]);
+    fprintf(f, "# %zu frames\n", hashes.size() / 2);
+    return fclose(f) != 0;
+}
+
+// PPM since anything can open it and it needs no library
+int Regression::savePPM(string file, uint32_t const *argb) {
+    FILE *f = fopen(file.c_str(), "wb");
+    if (f == NULL)
+        return 1;
+
+    fprintf(f, "P6\n160 144\n255\n");
+    for (int i=0; i<160*144; i++) {
+        uint8_t rgb[3] = {(uint8_t)(argb[i] >> 16), (uint8_t)(argb[i] >> 8), (uint8_t)argb[i]};
+        fwrite(rgb, 1, 3, f);
+    }
+    return fclose(f) != 0;
+}
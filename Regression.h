@@ -0,0 +1,35 @@
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include "Emulator.h"
+#include "Movie.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Checks that every game in a folder still plays out exactly the same,
+// started with -t [folder]. Each game runs with no window, playing back
+// [game].movie if there is one, and the hashes of every frame's picture
+// and machine state are compared with the ones in [game].golden. The first
+// frame that differs gets saved as [game].frame[n].ppm to look at. A game
+// with no .golden file yet gets one written, so delete it to accept a
+// change. The games run in parallel, one per core.
+class Regression {
+public:
+    // frames is how long to run games that have no movie or golden file
+    static int run(string dir, bool color_on, int frames);
+
+private:
+    struct Result {
+        string name;
+        bool passed;
+        string message;
+    };
+    static void check(string rom, bool color_on, int frames, Result *result);
+    static int readGolden(string file, vector<uint64_t> *hashes);
+    static int writeGolden(string file, vector<uint64_t> const &hashes);
+    static int savePPM(string file, uint32_t const *argb);
+};
+
+#endif
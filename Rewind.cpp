@@ -0,0 +1,204 @@
+#include "Rewind.h"
+#include "SaveState.h"
+
+Rewind::Rewind(CPU *cpu, size_t budget_bytes, int keyframe_interval) {
+    this->cpu = cpu;
+    this->budget_bytes = budget_bytes;
+    this->keyframe_interval = keyframe_interval;
+    state_size = SaveState::size(cpu);
+
+    reference.resize(state_size);
+    scratch.resize(state_size);
+    for (int i=0; i<num_buffers; i++)
+        free_buffers.push_back(vector<uint8_t>(state_size));
+
+    worker = thread(&Rewind::run, this);
+}
+
+Rewind::~Rewind() {
+    {
+        lock_guard<mutex> guard(lock);
+        quit = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void Rewind::push() {
+    unique_lock<mutex> guard(lock);
+    // worker has fallen behind, let it catch up rather than drop a frame
+    drained.wait(guard, [this] { return !free_buffers.empty(); });
+
+    vector<uint8_t> frame = move(free_buffers.back());
+    free_buffers.pop_back();
+    guard.unlock();
+
+    SaveState::save(cpu, frame.data(), state_size);
+
+    guard.lock();
+    pending.push_back(move(frame));
+    guard.unlock();
+    wake.notify_one();
+}
+
+int Rewind::pop() {
+    unique_lock<mutex> guard(lock);
+    waitForWorker(guard);
+
+    if (groups.empty())
+        return 1;
+
+    Group &group = groups.back();
+    if (!group.deltas.empty()) {
+        decode(group.deltas.back(), reference.data(), scratch.data(), state_size);
+        group.bytes -= group.deltas.back().size();
+        bytes_used -= group.deltas.back().size();
+        group.deltas.pop_back();
+        frames_stored--;
+    } else {
+        scratch = reference;
+
+        // the very oldest keyframe stays, holding rewind just sits on it
+        if (groups.size() > 1) {
+            bytes_used -= group.bytes;
+            groups.pop_back();
+            frames_stored--;
+            decode(groups.back().keyframe, NULL, reference.data(), state_size);
+        }
+    }
+
+    return SaveState::load(cpu, scratch.data(), state_size);
+}
+
+size_t Rewind::memoryUsed() {
+    lock_guard<mutex> guard(lock);
+    return bytes_used + (num_buffers + 2) * state_size;
+}
+
+int Rewind::framesStored() {
+    lock_guard<mutex> guard(lock);
+    return frames_stored;
+}
+
+void Rewind::waitForWorker(unique_lock<mutex> &guard) {
+    drained.wait(guard, [this] { return pending.empty() && !busy; });
+}
+
+void Rewind::run() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        wake.wait(guard, [this] { return quit || !pending.empty(); });
+        if (quit)
+            return;
+
+        vector<uint8_t> frame = move(pending.front());
+        pending.pop_front();
+        busy = true;
+        guard.unlock();
+
+        // groups and reference only change under the lock while the worker
+        // is idle, so encoding can run unlocked
+        vector<uint8_t> encoded;
+        bool keyframe = groups.empty() || (int)groups.back().deltas.size() + 1 >= keyframe_interval;
+        if (keyframe) {
+            encode(frame.data(), NULL, state_size, encoded);
+            memcpy(reference.data(), frame.data(), state_size);
+        } else {
+            encode(frame.data(), reference.data(), state_size, encoded);
+        }
+
+        guard.lock();
+        store(encoded, keyframe);
+        busy = false;
+        free_buffers.push_back(move(frame));
+        drained.notify_all();
+    }
+}
+
+void Rewind::store(vector<uint8_t> &encoded, bool keyframe) {
+    bytes_used += encoded.size();
+    frames_stored++;
+    if (keyframe) {
+        groups.push_back(Group());
+        groups.back().bytes = encoded.size();
+        groups.back().keyframe = move(encoded);
+    } else {
+        groups.back().bytes += encoded.size();
+        groups.back().deltas.push_back(move(encoded));
+    }
+
+    while (bytes_used > budget_bytes && groups.size() > 1) {
+        bytes_used -= groups.front().bytes;
+        frames_stored -= 1 + groups.front().deltas.size();
+        groups.pop_front();
+    }
+}
+
+static void putVarint(vector<uint8_t> &out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(value);
+}
+
+static size_t getVarint(uint8_t const *&in) {
+    size_t value = 0;
+    int shift = 0;
+    while (*in & 0x80) {
+        value |= (size_t)(*in++ & 0x7f) << shift;
+        shift += 7;
+    }
+    value |= (size_t)(*in++) << shift;
+    return value;
+}
+
+// Encodes frame XOR ref (ref NULL meaning all zero) as pairs of
+// [zero run length][literal length][literal bytes].
+void Rewind::encode(uint8_t const *frame, uint8_t const *ref, size_t size, vector<uint8_t> &out) {
+    out.clear();
+    size_t i = 0;
+    while (i < size) {
+        size_t start = i;
+        if (ref != NULL) {
+            while (i + 8 <= size && memcmp(frame + i, ref + i, 8) == 0) i += 8;
+            while (i < size && frame[i] == ref[i]) i++;
+        } else {
+            uint64_t word;
+            while (i + 8 <= size && (memcpy(&word, frame + i, 8), word == 0)) i += 8;
+            while (i < size && frame[i] == 0) i++;
+        }
+        putVarint(out, i - start);
+
+        // literals run until at least 8 unchanged bytes in a row
+        start = i;
+        size_t same = 0;
+        while (i < size && same < 8) {
+            uint8_t x = frame[i] ^ (ref != NULL ? ref[i] : 0);
+            same = x ? 0 : same + 1;
+            i++;
+        }
+        size_t end = i - same;
+        putVarint(out, end - start);
+        for (size_t j=start; j<end; j++)
+            out.push_back(frame[j] ^ (ref != NULL ? ref[j] : 0));
+        i = end;
+    }
+}
+
+void Rewind::decode(vector<uint8_t> const &in, uint8_t const *ref, uint8_t *out, size_t size) {
+    if (ref != NULL)
+        memcpy(out, ref, size);
+    else
+        memset(out, 0, size);
+
+    uint8_t const *p = in.data();
+    uint8_t const *end = p + in.size();
+    size_t i = 0;
+    while (p < end) {
+        i += getVarint(p);
+        size_t literals = getVarint(p);
+        for (size_t j=0; j<literals; j++)
+            out[i++] ^= *p++;
+    }
+}
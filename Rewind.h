@@ -0,0 +1,68 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "CPU.h"
+
+using namespace std;
+
+// History of per-frame save states for rewinding. Every keyframe_interval
+// frames a keyframe is stored, the frames in between are stored as the XOR
+// against that keyframe, run-length encoded; WRAM and VRAM barely change
+// between frames, so most of a delta is one long zero run. Encoding is done
+// on a background thread, push() itself only copies the state. When the
+// history outgrows its budget the oldest keyframe and its deltas go.
+class Rewind {
+public:
+    Rewind(CPU *cpu, size_t budget_bytes, int keyframe_interval = 60);
+    ~Rewind();
+
+    void push();
+    int pop();
+
+    size_t memoryUsed();
+    int framesStored();
+
+private:
+    struct Group {
+        vector<uint8_t> keyframe;
+        vector<vector<uint8_t>> deltas;
+        size_t bytes = 0;
+    };
+
+    CPU *cpu;
+    size_t state_size;
+    size_t budget_bytes;
+    int keyframe_interval;
+
+    deque<Group> groups;
+    size_t bytes_used = 0;
+    int frames_stored = 0;
+    vector<uint8_t> reference;  // decoded keyframe of groups.back()
+    vector<uint8_t> scratch;
+
+    static int const num_buffers = 4;
+    vector<vector<uint8_t>> free_buffers;
+    deque<vector<uint8_t>> pending;
+    bool busy = false;
+    bool quit = false;
+
+    thread worker;
+    mutex lock;
+    condition_variable wake;
+    condition_variable drained;
+
+    void run();
+    void store(vector<uint8_t> &encoded, bool keyframe);
+    void waitForWorker(unique_lock<mutex> &guard);
+
+    static void encode(uint8_t const *frame, uint8_t const *ref, size_t size, vector<uint8_t> &out);
+    static void decode(vector<uint8_t> const &in, uint8_t const *ref, uint8_t *out, size_t size);
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "SaveState.h"
+#include <fstream>
+#include <vector>
+
+size_t SaveState::size(CPU *cpu) {
+    return sizeof(SaveStateHeader) + sizeof(MachineState) + cpu->cartridge->RAM_size;
+}
+
+int SaveState::save(CPU *cpu, uint8_t *buffer, size_t buffer_size) {
+    if (buffer_size < size(cpu))
+        return 1;
+
+    SaveStateHeader header = {};
+    header.magic = SAVE_STATE_MAGIC;
+    header.version = SAVE_STATE_VERSION;
+    header.color_on = cpu->color_on;
+    header.state_size = sizeof(MachineState);
+    header.RAM_size = cpu->cartridge->RAM_size;
+    header.global_checksum = cpu->cartridge->image->getGlobalChecksum();
+
+    memcpy(buffer, &header, sizeof(SaveStateHeader));
+    buffer += sizeof(SaveStateHeader);
+    memcpy(buffer, cpu->state, sizeof(MachineState));
+
+    // banks a forked CPU still shares live outside its arena
+    for (int i=0; i<2; i++)
+        if (cpu->getBank(VRAM_BANK_ID + i) != cpu->state->VRAM[i])
+            memcpy(buffer + offsetof(MachineState, VRAM) + i * 0x2000, cpu->getBank(VRAM_BANK_ID + i), 0x2000);
+    for (int i=0; i<8; i++)
+        if (cpu->getBank(WRAM_BANK_ID + i) != cpu->state->WRAM[i])
+            memcpy(buffer + offsetof(MachineState, WRAM) + i * 0x1000, cpu->getBank(WRAM_BANK_ID + i), 0x1000);
+
+    buffer += sizeof(MachineState);
+    for (uint32_t i=0; i<header.RAM_size / 0x2000; i++)
+        memcpy(buffer + i * 0x2000, cpu->getBank(EXT_BANK_ID + i), 0x2000);
+
+    return 0;
+}
+
+int SaveState::load(CPU *cpu, uint8_t const *buffer, size_t buffer_size) {
+    SaveStateHeader header;
+    if (buffer_size < sizeof(SaveStateHeader))
+        return 1;
+    memcpy(&header, buffer, sizeof(SaveStateHeader));
+
+    if (header.magic != SAVE_STATE_MAGIC || header.version != SAVE_STATE_VERSION) {
+        cout << "Not a save state, or one from another version." << endl;
+        return 1;
+    }
+    if (header.state_size != sizeof(MachineState) || header.color_on != cpu->color_on ||
+        header.RAM_size != cpu->cartridge->RAM_size ||
+        header.global_checksum != cpu->cartridge->image->getGlobalChecksum() ||
+        buffer_size < size(cpu)) {
+        cout << "Save state doesn't match this game." << endl;
+        return 1;
+    }
+
+    buffer += sizeof(SaveStateHeader);
+    memcpy(cpu->state, buffer, sizeof(MachineState));
+    buffer += sizeof(MachineState);
+    // leave the save file alone unless the state really changes it
+    if (header.RAM_size && memcmp(cpu->cartridge->getRAM(), buffer, header.RAM_size) != 0) {
+        memcpy(cpu->cartridge->getRAM(), buffer, header.RAM_size);
+        cpu->cartridge->markAllDirty();
+    }
+
+    cpu->resetBanks();
+    return 0;
+}
+
+int SaveState::saveFile(CPU *cpu, string file) {
+    vector<uint8_t> buffer(size(cpu));
+    save(cpu, buffer.data(), buffer.size());
+
+    ofstream out(file, ofstream::binary);
+    if (!out.good()) {
+        cout << "Couldn't write '" << file << "'!" << endl;
+        return 1;
+    }
+
+    out.write((char*)buffer.data(), buffer.size());
+    out.close();
+    return 0;
+}
+
+int SaveState::loadFile(CPU *cpu, string file) {
+    ifstream f(file, ios::in|ios::binary|ios::ate);
+    if (!f.good()) {
+        cout << "Couldn't read '" << file << "'!" << endl;
+        return 1;
+    }
+
+    int fsize = f.tellg();
+    f.seekg(ios::beg);
+    vector<uint8_t> buffer(fsize);
+    f.read((char*)buffer.data(), fsize);
+    f.close();
+
+    return load(cpu, buffer.data(), buffer.size());
+}
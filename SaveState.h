@@ -0,0 +1,37 @@
+#ifndef SAVE_STATE_H
+#define SAVE_STATE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include "CPU.h"
+
+using namespace std;
+
+#define SAVE_STATE_MAGIC 0x54534247 // "GBST"
+#define SAVE_STATE_VERSION 4
+
+// A save state is this header, the raw MachineState arena and then the
+// external RAM. The arena is dumped as-is, so the version has to be bumped
+// whenever MachineState changes layout; state_size catches the rest.
+struct SaveStateHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t color_on;
+    uint32_t state_size;
+    uint32_t RAM_size;
+    uint16_t global_checksum;
+    uint16_t reserved;
+};
+
+class SaveState {
+public:
+    static size_t size(CPU *cpu);
+    static int save(CPU *cpu, uint8_t *buffer, size_t buffer_size);
+    static int load(CPU *cpu, uint8_t const *buffer, size_t buffer_size);
+
+    static int saveFile(CPU *cpu, string file);
+    static int loadFile(CPU *cpu, string file);
+};
+
+#endif
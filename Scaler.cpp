@@ -0,0 +1,524 @@
+#include "Scaler.h"
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCALER_X86
+#endif
+
+static char const *const names[NUM_SCALERS] = {"none", "nearest", "2x", "3x", "4x", "xbr"};
+
+Scaler::Scaler(int width, int height) {
+    this->width = width;
+    this->height = height;
+    padded.resize((width + 4) * (height + 4));
+    yuv.resize((width + 4) * (height + 4));
+    doubled.resize(4 * width * height);
+    doubled_padded.resize((2 * width + 4) * (2 * height + 4));
+}
+
+void Scaler::setFilter(int filter) {
+    if (filter < 0 || filter >= NUM_SCALERS)
+        filter = SCALER_NONE;
+    this->filter = filter;
+}
+
+int Scaler::getFilter() {
+    return filter;
+}
+
+int Scaler::factor() {
+    if (filter == SCALER_NONE)
+        return 1;
+    return filter == SCALER_3X ? 3 : 4;
+}
+
+int Scaler::reach() {
+    if (filter == SCALER_NONE || filter == SCALER_NEAREST)
+        return 0;
+    // Scale2x twice looks one doubled row out, which is two source rows
+    return filter == SCALER_XBR || filter == SCALER_4X ? 2 : 1;
+}
+
+char const *Scaler::name(int filter) {
+    return filter >= 0 && filter < NUM_SCALERS ? names[filter] : "?";
+}
+
+int Scaler::find(char const *name) {
+    for (int i=0; i<NUM_SCALERS; i++)
+        if (strcmp(name, names[i]) == 0)
+            return i;
+    return -1;
+}
+
+// Padded row y, pointing at pixel 0 of it.
+static inline uint32_t *row(uint32_t *padded, int width, int y) {
+    return padded + (y + 2) * (width + 4) + 2;
+}
+
+void Scaler::pad(uint32_t const *src, int width, int height, int first, int last, uint32_t *out) {
+    int from = first - 2 < -2 ? -2 : first - 2;
+    int to = last + 2 > height + 2 ? height + 2 : last + 2;
+    for (int y=from; y<to; y++) {
+        int sy = y < 0 ? 0 : y >= height ? height - 1 : y;
+        uint32_t *line = row(out, width, y);
+        memcpy(line, src + sy * width, width * sizeof(uint32_t));
+        line[-2] = line[-1] = line[0];
+        line[width] = line[width + 1] = line[width - 1];
+    }
+}
+
+static inline uint32_t average(uint32_t a, uint32_t b) {
+    // per channel, rounding up like _mm_avg_epu8
+    return (a | b) - (((a ^ b) >> 1) & 0x7f7f7f7f);
+}
+
+// ---- scalar versions, for other CPUs and the pixels left at the end of a
+// row
+
+static void nearestScalar(uint32_t const *in, int from, int width, uint32_t *out) {
+    for (int x=from; x<width; x++)
+        out[4*x] = out[4*x+1] = out[4*x+2] = out[4*x+3] = in[x];
+}
+
+static void widenScalar(uint32_t *line, int from, int to) {
+    for (int x=to-1; x>=from; x--)
+        line[2*x] = line[2*x+1] = line[x];
+}
+
+static void scale2xScalar(uint32_t const *above, uint32_t const *in, uint32_t const *below,
+                          int from, int width, uint32_t *out0, uint32_t *out1) {
+    for (int x=from; x<width; x++) {
+        uint32_t B = above[x], D = in[x-1], E = in[x], F = in[x+1], H = below[x];
+        out0[2*x]   = D == B && B != F && D != H ? D : E;
+        out0[2*x+1] = B == F && B != D && F != H ? F : E;
+        out1[2*x]   = D == H && D != B && H != F ? D : E;
+        out1[2*x+1] = H == F && D != H && B != F ? F : E;
+    }
+}
+
+static void scale3xScalar(uint32_t const *above, uint32_t const *in, uint32_t const *below,
+                          int from, int width, uint32_t *out0, uint32_t *out1, uint32_t *out2) {
+    for (int x=from; x<width; x++) {
+        uint32_t A = above[x-1], B = above[x], C = above[x+1];
+        uint32_t D = in[x-1], E = in[x], F = in[x+1];
+        uint32_t G = below[x-1], H = below[x], I = below[x+1];
+        bool c0 = D == B && B != F && D != H;
+        bool c1 = B == F && B != D && F != H;
+        bool c2 = D == H && D != B && H != F;
+        bool c3 = H == F && D != H && B != F;
+        out0[3*x]   = c0 ? D : E;
+        out0[3*x+1] = (c0 && E != C) || (c1 && E != A) ? B : E;
+        out0[3*x+2] = c1 ? F : E;
+        out1[3*x]   = (c0 && E != G) || (c2 && E != A) ? D : E;
+        out1[3*x+1] = E;
+        out1[3*x+2] = (c1 && E != I) || (c3 && E != C) ? F : E;
+        out2[3*x]   = c2 ? D : E;
+        out2[3*x+1] = (c2 && E != I) || (c3 && E != G) ? H : E;
+        out2[3*x+2] = c3 ? F : E;
+    }
+}
+
+// Y, U and V packed into the low three bytes, which is what xBR measures
+// how different two colors are with.
+static inline uint32_t toYUV(uint32_t argb) {
+    int R = (argb >> 16) & 0xff, G = (argb >> 8) & 0xff, B = argb & 0xff;
+    int Y = (77 * R + 150 * G + 29 * B) >> 8;
+    int U = (-43 * R - 85 * G + 128 * B + 32768) >> 8;
+    int V = (128 * R - 107 * G - 21 * B + 32768) >> 8;
+    return Y | (U << 8) | (V << 16);
+}
+
+static inline int channel(uint32_t a, uint32_t b, int shift) {
+    int d = (int)((a >> shift) & 0xff) - (int)((b >> shift) & 0xff);
+    return d < 0 ? -d : d;
+}
+
+static inline int distance(uint32_t a, uint32_t b) {
+    return 48 * channel(a, b, 0) + 7 * channel(a, b, 8) + 6 * channel(a, b, 16);
+}
+
+// One corner of a pixel E, drawn as if it were the bottom right one with
+// I diagonally past it (the callers rotate the neighbourhood for the other
+// three). If the neighbourhood says there's an edge running between H and
+// F, the corner gets blended half way towards whichever of them is closer
+// to E. Capital letters are YUV, e, f and h the colors.
+static inline uint32_t xbrCorner(uint32_t E, uint32_t I, uint32_t H, uint32_t F, uint32_t G, uint32_t C,
+                                 uint32_t D, uint32_t B, uint32_t F4, uint32_t I4, uint32_t H5, uint32_t I5,
+                                 uint32_t e, uint32_t f, uint32_t h) {
+    if (e == h || e == f)
+        return e;
+    int along = distance(E, C) + distance(E, G) + distance(I, H5) + distance(I, F4) + 4 * distance(H, F);
+    int across = distance(H, D) + distance(H, I5) + distance(F, I4) + distance(F, B) + 4 * distance(E, I);
+    if (along >= across)
+        return e;
+    return average(e, distance(E, F) <= distance(E, H) ? f : h);
+}
+
+//      A1 B1 C1
+//   A0  A  B  C C4
+//   D0  D  E  F F4
+//   G0  G  H  I I4
+//      G5 H5 I5
+static void xbrScalar(uint32_t const *const *yuv, uint32_t const *const *rgb,
+                      int from, int width, uint32_t *out0, uint32_t *out1) {
+    for (int x=from; x<width; x++) {
+        uint32_t A1 = yuv[0][x-1], B1 = yuv[0][x], C1 = yuv[0][x+1];
+        uint32_t A0 = yuv[1][x-2], A = yuv[1][x-1], B = yuv[1][x], C = yuv[1][x+1], C4 = yuv[1][x+2];
+        uint32_t D0 = yuv[2][x-2], D = yuv[2][x-1], E = yuv[2][x], F = yuv[2][x+1], F4 = yuv[2][x+2];
+        uint32_t G0 = yuv[3][x-2], G = yuv[3][x-1], H = yuv[3][x], I = yuv[3][x+1], I4 = yuv[3][x+2];
+        uint32_t G5 = yuv[4][x-1], H5 = yuv[4][x], I5 = yuv[4][x+1];
+        uint32_t b = rgb[0][x], d = rgb[1][x-1], e = rgb[1][x], f = rgb[1][x+1], h = rgb[2][x];
+
+        out0[2*x]   = xbrCorner(E, A, B, D, C, G, F, H, D0, A0, B1, A1, e, d, b);
+        out0[2*x+1] = xbrCorner(E, C, F, B, I, A, H, D, B1, C1, F4, C4, e, b, f);
+        out1[2*x]   = xbrCorner(E, G, D, H, A, I, B, F, H5, G5, D0, G0, e, h, d);
+        out1[2*x+1] = xbrCorner(E, I, H, F, G, C, D, B, F4, I4, H5, I5, e, f, h);
+    }
+}
+
+#ifdef SCALER_X86
+// ---- SSE2, 4 pixels at a time
+
+static inline __m128i load(uint32_t const *p) {
+    return _mm_loadu_si128((__m128i const*)p);
+}
+
+static inline void store(uint32_t *p, __m128i v) {
+    _mm_storeu_si128((__m128i*)p, v);
+}
+
+static inline __m128i select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// a0 b0 a1 b1 ... for 8 pixels
+static inline void storePairs(uint32_t *p, __m128i a, __m128i b) {
+    store(p, _mm_unpacklo_epi32(a, b));
+    store(p + 4, _mm_unpackhi_epi32(a, b));
+}
+
+static void nearestSSE2(uint32_t const *in, int width, uint32_t *out) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i v = load(in + x);
+        store(out + 4*x,      _mm_shuffle_epi32(v, 0x00));
+        store(out + 4*x + 4,  _mm_shuffle_epi32(v, 0x55));
+        store(out + 4*x + 8,  _mm_shuffle_epi32(v, 0xaa));
+        store(out + 4*x + 12, _mm_shuffle_epi32(v, 0xff));
+    }
+    nearestScalar(in, x, width, out);
+}
+
+// Doubles the width of a row in place, working from the right so nothing
+// gets overwritten before it's read.
+static void widenSSE2(uint32_t *line, int width) {
+    int x = width & ~3;
+    widenScalar(line, x, width);
+    while (x > 0) {
+        x -= 4;
+        __m128i v = load(line + x);
+        storePairs(line + 2*x, v, v);
+    }
+}
+
+static void scale2xSSE2(uint32_t const *above, uint32_t const *in, uint32_t const *below,
+                        int width, uint32_t *out0, uint32_t *out1) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i B = load(above + x), D = load(in + x - 1), E = load(in + x);
+        __m128i F = load(in + x + 1), H = load(below + x);
+        __m128i BD = _mm_cmpeq_epi32(B, D), BF = _mm_cmpeq_epi32(B, F);
+        __m128i DH = _mm_cmpeq_epi32(D, H), HF = _mm_cmpeq_epi32(H, F);
+        __m128i c0 = _mm_andnot_si128(_mm_or_si128(BF, DH), BD);
+        __m128i c1 = _mm_andnot_si128(_mm_or_si128(BD, HF), BF);
+        __m128i c2 = _mm_andnot_si128(_mm_or_si128(BD, HF), DH);
+        __m128i c3 = _mm_andnot_si128(_mm_or_si128(DH, BF), HF);
+        storePairs(out0 + 2*x, select(c0, D, E), select(c1, F, E));
+        storePairs(out1 + 2*x, select(c2, D, E), select(c3, F, E));
+    }
+    scale2xScalar(above, in, below, x, width, out0, out1);
+}
+
+static void scale3xSSE2(uint32_t const *above, uint32_t const *in, uint32_t const *below,
+                        int width, uint32_t *out0, uint32_t *out1, uint32_t *out2) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i A = load(above + x - 1), B = load(above + x), C = load(above + x + 1);
+        __m128i D = load(in + x - 1), E = load(in + x), F = load(in + x + 1);
+        __m128i G = load(below + x - 1), H = load(below + x), I = load(below + x + 1);
+        __m128i BD = _mm_cmpeq_epi32(B, D), BF = _mm_cmpeq_epi32(B, F);
+        __m128i DH = _mm_cmpeq_epi32(D, H), HF = _mm_cmpeq_epi32(H, F);
+        __m128i EA = _mm_cmpeq_epi32(E, A), EC = _mm_cmpeq_epi32(E, C);
+        __m128i EG = _mm_cmpeq_epi32(E, G), EI = _mm_cmpeq_epi32(E, I);
+        __m128i c0 = _mm_andnot_si128(_mm_or_si128(BF, DH), BD);
+        __m128i c1 = _mm_andnot_si128(_mm_or_si128(BD, HF), BF);
+        __m128i c2 = _mm_andnot_si128(_mm_or_si128(BD, HF), DH);
+        __m128i c3 = _mm_andnot_si128(_mm_or_si128(DH, BF), HF);
+
+        // the 3x3 blocks get put together a pixel at a time, SSE2 has no
+        // good way to interleave three vectors
+        uint32_t block[9][4];
+        store(block[0], select(c0, D, E));
+        store(block[1], select(_mm_or_si128(_mm_andnot_si128(EC, c0), _mm_andnot_si128(EA, c1)), B, E));
+        store(block[2], select(c1, F, E));
+        store(block[3], select(_mm_or_si128(_mm_andnot_si128(EG, c0), _mm_andnot_si128(EA, c2)), D, E));
+        store(block[4], E);
+        store(block[5], select(_mm_or_si128(_mm_andnot_si128(EI, c1), _mm_andnot_si128(EC, c3)), F, E));
+        store(block[6], select(c2, D, E));
+        store(block[7], select(_mm_or_si128(_mm_andnot_si128(EI, c2), _mm_andnot_si128(EG, c3)), H, E));
+        store(block[8], select(c3, F, E));
+        uint32_t *out[3] = {out0, out1, out2};
+        for (int i=0; i<4; i++)
+            for (int r=0; r<3; r++)
+                for (int c=0; c<3; c++)
+                    out[r][3*(x+i) + c] = block[3*r + c][i];
+    }
+    scale3xScalar(above, in, below, x, width, out0, out1, out2);
+}
+
+// distance() for 4 pairs of YUV pixels at once
+static inline __m128i distanceSSE2(__m128i a, __m128i b) {
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const weights = _mm_setr_epi16(48, 7, 6, 0, 48, 7, 6, 0);
+    __m128i d = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(d, zero), weights);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(d, zero), weights);
+    return _mm_madd_epi16(_mm_packs_epi32(lo, hi), _mm_set1_epi16(1));
+}
+
+static inline __m128i xbrCornerSSE2(__m128i E, __m128i I, __m128i H, __m128i F, __m128i G, __m128i C,
+                                    __m128i D, __m128i B, __m128i F4, __m128i I4, __m128i H5, __m128i I5,
+                                    __m128i e, __m128i f, __m128i h) {
+    __m128i along = _mm_add_epi32(_mm_add_epi32(distanceSSE2(E, C), distanceSSE2(E, G)),
+                                  _mm_add_epi32(distanceSSE2(I, H5), distanceSSE2(I, F4)));
+    along = _mm_add_epi32(along, _mm_slli_epi32(distanceSSE2(H, F), 2));
+    __m128i across = _mm_add_epi32(_mm_add_epi32(distanceSSE2(H, D), distanceSSE2(H, I5)),
+                                   _mm_add_epi32(distanceSSE2(F, I4), distanceSSE2(F, B)));
+    across = _mm_add_epi32(across, _mm_slli_epi32(distanceSSE2(E, I), 2));
+
+    __m128i edge = _mm_cmplt_epi32(along, across);
+    edge = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi32(e, h), _mm_cmpeq_epi32(e, f)), edge);
+    __m128i use_h = _mm_cmpgt_epi32(distanceSSE2(E, F), distanceSSE2(E, H));
+    __m128i blended = _mm_avg_epu8(e, select(use_h, h, f));
+    return select(edge, blended, e);
+}
+
+static void xbrSSE2(uint32_t const *const *yuv, uint32_t const *const *rgb,
+                    int width, uint32_t *out0, uint32_t *out1) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i A1 = load(yuv[0] + x - 1), B1 = load(yuv[0] + x), C1 = load(yuv[0] + x + 1);
+        __m128i A0 = load(yuv[1] + x - 2), A = load(yuv[1] + x - 1), B = load(yuv[1] + x);
+        __m128i C = load(yuv[1] + x + 1), C4 = load(yuv[1] + x + 2);
+        __m128i D0 = load(yuv[2] + x - 2), D = load(yuv[2] + x - 1), E = load(yuv[2] + x);
+        __m128i F = load(yuv[2] + x + 1), F4 = load(yuv[2] + x + 2);
+        __m128i G0 = load(yuv[3] + x - 2), G = load(yuv[3] + x - 1), H = load(yuv[3] + x);
+        __m128i I = load(yuv[3] + x + 1), I4 = load(yuv[3] + x + 2);
+        __m128i G5 = load(yuv[4] + x - 1), H5 = load(yuv[4] + x), I5 = load(yuv[4] + x + 1);
+        __m128i b = load(rgb[0] + x), d = load(rgb[1] + x - 1), e = load(rgb[1] + x);
+        __m128i f = load(rgb[1] + x + 1), h = load(rgb[2] + x);
+
+        storePairs(out0 + 2*x, xbrCornerSSE2(E, A, B, D, C, G, F, H, D0, A0, B1, A1, e, d, b),
+                               xbrCornerSSE2(E, C, F, B, I, A, H, D, B1, C1, F4, C4, e, b, f));
+        storePairs(out1 + 2*x, xbrCornerSSE2(E, G, D, H, A, I, B, F, H5, G5, D0, G0, e, h, d),
+                               xbrCornerSSE2(E, I, H, F, G, C, D, B, F4, I4, H5, I5, e, f, h));
+    }
+    xbrScalar(yuv, rgb, x, width, out0, out1);
+}
+
+// ---- AVX2, 8 pixels at a time, for the two simplest filters where the
+// extra width pays off the most
+
+__attribute__((target("avx2")))
+static void nearestAVX2(uint32_t const *in, int width, uint32_t *out) {
+    __m256i const spread[4] = {
+        _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1), _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3),
+        _mm256_setr_epi32(4, 4, 4, 4, 5, 5, 5, 5), _mm256_setr_epi32(6, 6, 6, 6, 7, 7, 7, 7)
+    };
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i v = _mm256_loadu_si256((__m256i const*)(in + x));
+        for (int k=0; k<4; k++)
+            _mm256_storeu_si256((__m256i*)(out + 4*x + 8*k), _mm256_permutevar8x32_epi32(v, spread[k]));
+    }
+    nearestScalar(in, x, width, out);
+}
+
+__attribute__((target("avx2")))
+static inline void storePairsAVX2(uint32_t *p, __m256i a, __m256i b) {
+    // the unpacks work within each 128 bit half, so the halves come out
+    // in the wrong order
+    __m256i lo = _mm256_unpacklo_epi32(a, b), hi = _mm256_unpackhi_epi32(a, b);
+    _mm256_storeu_si256((__m256i*)p, _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i*)(p + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+__attribute__((target("avx2")))
+static void scale2xAVX2(uint32_t const *above, uint32_t const *in, uint32_t const *below,
+                        int width, uint32_t *out0, uint32_t *out1) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i B = _mm256_loadu_si256((__m256i const*)(above + x));
+        __m256i D = _mm256_loadu_si256((__m256i const*)(in + x - 1));
+        __m256i E = _mm256_loadu_si256((__m256i const*)(in + x));
+        __m256i F = _mm256_loadu_si256((__m256i const*)(in + x + 1));
+        __m256i H = _mm256_loadu_si256((__m256i const*)(below + x));
+        __m256i BD = _mm256_cmpeq_epi32(B, D), BF = _mm256_cmpeq_epi32(B, F);
+        __m256i DH = _mm256_cmpeq_epi32(D, H), HF = _mm256_cmpeq_epi32(H, F);
+        __m256i c0 = _mm256_andnot_si256(_mm256_or_si256(BF, DH), BD);
+        __m256i c1 = _mm256_andnot_si256(_mm256_or_si256(BD, HF), BF);
+        __m256i c2 = _mm256_andnot_si256(_mm256_or_si256(BD, HF), DH);
+        __m256i c3 = _mm256_andnot_si256(_mm256_or_si256(DH, BF), HF);
+        storePairsAVX2(out0 + 2*x, _mm256_blendv_epi8(E, D, c0), _mm256_blendv_epi8(E, F, c1));
+        storePairsAVX2(out1 + 2*x, _mm256_blendv_epi8(E, D, c2), _mm256_blendv_epi8(E, F, c3));
+    }
+    scale2xScalar(above, in, below, x, width, out0, out1);
+}
+#endif
+
+// ---- picking a version
+
+#ifdef SCALER_X86
+static bool hasAVX2() {
+    static bool const has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+#endif
+
+static void nearestRow(uint32_t const *in, int width, uint32_t *out) {
+#ifdef SCALER_X86
+    if (hasAVX2())
+        nearestAVX2(in, width, out);
+    else
+        nearestSSE2(in, width, out);
+#else
+    nearestScalar(in, 0, width, out);
+#endif
+}
+
+static void scale2xRow(uint32_t const *above, uint32_t const *in, uint32_t const *below,
+                       int width, uint32_t *out0, uint32_t *out1) {
+#ifdef SCALER_X86
+    if (hasAVX2())
+        scale2xAVX2(above, in, below, width, out0, out1);
+    else
+        scale2xSSE2(above, in, below, width, out0, out1);
+#else
+    scale2xScalar(above, in, below, 0, width, out0, out1);
+#endif
+}
+
+static void scale3xRow(uint32_t const *above, uint32_t const *in, uint32_t const *below,
+                       int width, uint32_t *out0, uint32_t *out1, uint32_t *out2) {
+#ifdef SCALER_X86
+    scale3xSSE2(above, in, below, width, out0, out1, out2);
+#else
+    scale3xScalar(above, in, below, 0, width, out0, out1, out2);
+#endif
+}
+
+static void xbrRow(uint32_t const *const *yuv, uint32_t const *const *rgb,
+                   int width, uint32_t *out0, uint32_t *out1) {
+#ifdef SCALER_X86
+    xbrSSE2(yuv, rgb, width, out0, out1);
+#else
+    xbrScalar(yuv, rgb, 0, width, out0, out1);
+#endif
+}
+
+// A 2x row (width pixels wide doubled) made 4x: twice as wide and written
+// out twice.
+static void stretchRow(uint32_t *line, int width, int stride) {
+#ifdef SCALER_X86
+    widenSSE2(line, 2 * width);
+#else
+    widenScalar(line, 0, 2 * width);
+#endif
+    memcpy(line + stride, line, 4 * width * sizeof(uint32_t));
+}
+
+void Scaler::scale(uint32_t const *src, int first, int last, uint32_t *out, int pitch) {
+    int stride = pitch / sizeof(uint32_t);
+    uint32_t *p = padded.data();
+
+    switch (filter) {
+    case SCALER_NEAREST:
+        for (int y=first; y<last; y++) {
+            uint32_t *line = out + (y - first) * 4 * stride;
+            nearestRow(src + y * width, width, line);
+            for (int i=1; i<4; i++)
+                memcpy(line + i * stride, line, 4 * width * sizeof(uint32_t));
+        }
+        break;
+
+    case SCALER_2X:
+        pad(src, width, height, first, last, p);
+        for (int y=first; y<last; y++) {
+            uint32_t *line = out + (y - first) * 4 * stride;
+            scale2xRow(row(p, width, y-1), row(p, width, y), row(p, width, y+1), width,
+                       line, line + 2 * stride);
+            stretchRow(line, width, stride);
+            stretchRow(line + 2 * stride, width, stride);
+        }
+        break;
+
+    case SCALER_3X:
+        pad(src, width, height, first, last, p);
+        for (int y=first; y<last; y++) {
+            uint32_t *line = out + (y - first) * 3 * stride;
+            scale3xRow(row(p, width, y-1), row(p, width, y), row(p, width, y+1), width,
+                       line, line + stride, line + 2 * stride);
+        }
+        break;
+
+    case SCALER_4X: {
+        // Scale2x of Scale2x; the second pass needs a row of the first
+        // one's output above and below
+        int from = first > 0 ? first - 1 : 0;
+        int to = last < height ? last + 1 : height;
+        pad(src, width, height, from, to, p);
+        uint32_t *d = doubled.data();
+        for (int y=from; y<to; y++)
+            scale2xRow(row(p, width, y-1), row(p, width, y), row(p, width, y+1), width,
+                       d + 2*y * 2*width, d + (2*y+1) * 2*width);
+
+        uint32_t *dp = doubled_padded.data();
+        pad(d, 2*width, 2*height, 2*first, 2*last, dp);
+        for (int y=2*first; y<2*last; y++) {
+            uint32_t *line = out + (y - 2*first) * 2 * stride;
+            scale2xRow(row(dp, 2*width, y-1), row(dp, 2*width, y), row(dp, 2*width, y+1), 2*width,
+                       line, line + stride);
+        }
+        break;
+    }
+
+    case SCALER_XBR: {
+        pad(src, width, height, first, last, p);
+        int from = first - 2 < -2 ? -2 : first - 2;
+        int to = last + 2 > height + 2 ? height + 2 : last + 2;
+        for (int y=from; y<to; y++) {
+            uint32_t const *in = row(p, width, y) - 2;
+            uint32_t *line = row(yuv.data(), width, y) - 2;
+            for (int x=0; x<width+4; x++)
+                line[x] = toYUV(in[x]);
+        }
+
+        for (int y=first; y<last; y++) {
+            uint32_t const *yuv_rows[5];
+            for (int i=0; i<5; i++)
+                yuv_rows[i] = row(yuv.data(), width, y - 2 + i);
+            uint32_t const *rgb_rows[3] = {row(p, width, y-1), row(p, width, y), row(p, width, y+1)};
+            uint32_t *line = out + (y - first) * 4 * stride;
+            xbrRow(yuv_rows, rgb_rows, width, line, line + 2 * stride);
+            stretchRow(line, width, stride);
+            stretchRow(line + 2 * stride, width, stride);
+        }
+        break;
+    }
+
+    default:
+        for (int y=first; y<last; y++)
+            memcpy(out + (y - first) * stride, src + y * width, width * sizeof(uint32_t));
+        break;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef SCALER_H
+#define SCALER_H
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+#define SCALER_NONE    0 // left to SDL
+#define SCALER_NEAREST 1 // 4x, each pixel a 4x4 block
+#define SCALER_2X      2 // Scale2x, then doubled to 4x
+#define SCALER_3X      3 // Scale3x
+#define SCALER_4X      4 // Scale2x twice
+#define SCALER_XBR     5 // xBR-style 2x, then doubled to 4x
+#define NUM_SCALERS    6
+
+// Blows frames up on the CPU, so the renderer only has to copy the result
+// 1:1 to the window. That matters with SDL's software renderer, where
+// stretching a 160x144 texture to the window is slow. The pixel art
+// filters smooth diagonals without blurring: Scale2x/3x only ever copy
+// neighbouring pixels, xBR looks further out and blends along edges.
+class Scaler {
+public:
+    Scaler(int width, int height);
+    void setFilter(int filter);
+    int getFilter();
+    // how many times bigger the output is
+    int factor();
+    // output rows for a source row depend on this many rows above and
+    // below it, so those have to be redone when it changes too
+    int reach();
+    // Scales source rows first to last-1 of a width x height frame. out is
+    // where the first output row goes, pitch is in bytes.
+    void scale(uint32_t const *src, int first, int last, uint32_t *out, int pitch);
+
+    static char const *name(int filter);
+    // by name, or -1
+    static int find(char const *name);
+
+private:
+    int width, height;
+    int filter = SCALER_NONE;
+
+    // the source (and for Scale4x, the 2x frame) with its edge pixels
+    // repeated 2 more times all around, so the filters never have to check
+    // for the edge
+    vector<uint32_t> padded;
+    vector<uint32_t> yuv;
+    vector<uint32_t> doubled;
+    vector<uint32_t> doubled_padded;
+    static void pad(uint32_t const *src, int width, int height, int first, int last, uint32_t *out);
+};
+
+#endif
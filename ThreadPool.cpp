@@ -0,0 +1,128 @@
+#include "ThreadPool.h"
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+ThreadPool::ThreadPool(int num_threads) {
+    // the cores this process is allowed on, which under taskset or a
+    // container can be fewer than the machine has (and not numbered 0..n)
+    vector<int> cores;
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int c=0; c<CPU_SETSIZE; c++)
+            if (CPU_ISSET(c, &allowed))
+                cores.push_back(c);
+    }
+#endif
+    int num_cores = cores.empty() ? thread::hardware_concurrency() : cores.size();
+    if (num_cores < 1)
+        num_cores = 1;
+    if (num_threads <= 0)
+        num_threads = num_cores;
+
+    for (int i=0; i<num_threads; i++)
+        workers.emplace_back(new Worker());
+
+    for (int i=0; i<num_threads; i++) {
+        workers[i]->handle = thread(&ThreadPool::work, this, i);
+#ifdef __linux__
+        if (!cores.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cores[i % cores.size()], &set);
+            pthread_setaffinity_np(workers[i]->handle.native_handle(), sizeof(set), &set);
+        }
+#endif
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers)
+        worker->handle.join();
+}
+
+int ThreadPool::size() {
+    return workers.size();
+}
+
+void ThreadPool::run(int num_tasks, function<void(int)> const &task) {
+    if (num_tasks <= 0)
+        return;
+
+    unique_lock<mutex> guard(lock);
+    // a worker that woke up late for the last batch could still be looking
+    // at the queues with the last task
+    done.wait(guard, [this] { return active == 0; });
+
+    int n = workers.size();
+    for (int i=0; i<n; i++) {
+        lock_guard<mutex> queue_guard(workers[i]->lock);
+        for (int t=(long)num_tasks*i/n; t<(long)num_tasks*(i+1)/n; t++)
+            workers[i]->tasks.push_back(t);
+    }
+    this->task = &task;
+    remaining = num_tasks;
+    generation++;
+    wake.notify_all();
+
+    done.wait(guard, [this] { return remaining == 0 && active == 0; });
+    this->task = NULL;
+}
+
+// Own queue from the front, then everyone else's from the back.
+bool ThreadPool::next(int id, int &index) {
+    int n = workers.size();
+    for (int k=0; k<n; k++) {
+        Worker &worker = *workers[(id + k) % n];
+        lock_guard<mutex> guard(worker.lock);
+        if (worker.tasks.empty())
+            continue;
+
+        if (k == 0) {
+            index = worker.tasks.front();
+            worker.tasks.pop_front();
+        } else {
+            index = worker.tasks.back();
+            worker.tasks.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::work(int id) {
+    int seen = 0;
+    while (true) {
+        function<void(int)> const *current;
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [&] { return quit || generation != seen; });
+            if (quit)
+                return;
+            seen = generation;
+            current = task;
+            active++;
+        }
+
+        int index;
+        while (next(id, index)) {
+            (*current)(index);
+            remaining--;
+        }
+
+        {
+            lock_guard<mutex> guard(lock);
+            active--;
+            if (active == 0)
+                done.notify_all();
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+using namespace std;
+
+// Fixed set of worker threads, one pinned to each core the process may run
+// on, that run batches of numbered tasks. Each worker starts on its own
+// slice of the batch and steals from the back of the others' queues when it
+// runs out, so a few slow tasks (a game doing more work that frame) don't
+// hold up the batch.
+class ThreadPool {
+public:
+    ThreadPool(int num_threads = 0);
+    ~ThreadPool();
+
+    // calls task(i) for every i in [0, num_tasks), returns once all are done
+    void run(int num_tasks, function<void(int)> const &task);
+    int size();
+
+private:
+    struct Worker {
+        mutex lock;
+        deque<int> tasks;
+        thread handle;
+    };
+    vector<unique_ptr<Worker>> workers;
+
+    function<void(int)> const *task = NULL;
+    atomic<int> remaining{0};
+    int generation = 0;
+    int active = 0;
+    bool quit = false;
+
+    mutex lock;
+    condition_variable wake;
+    condition_variable done;
+
+    void work(int id);
+    bool next(int id, int &index);
+};
+
+#endif
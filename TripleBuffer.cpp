@@ -0,0 +1,43 @@
+#include "TripleBuffer.h"
+
+TripleBuffer::TripleBuffer(int width, int height) : middle(1) {
+    this->height = height;
+    for (int i=0; i<3; i++) {
+        slots[i].pixels.assign(width * height, 0);
+        slots[i].row_frames.assign(height, 0);
+    }
+    row_frames.assign(height, 0);
+}
+
+uint32_t *TripleBuffer::back() {
+    return slots[back_index].pixels.data();
+}
+
+void TripleBuffer::publish(bool const *changed_rows) {
+    frame++;
+    for (int y=0; y<height; y++) {
+        if (changed_rows[y])
+            row_frames[y] = frame;
+    }
+
+    Slot &slot = slots[back_index];
+    slot.row_frames = row_frames;
+    slot.frame = frame;
+    back_index = middle.exchange(back_index | FRESH, memory_order_acq_rel) & 3;
+}
+
+bool TripleBuffer::update() {
+    if (!(middle.load(memory_order_relaxed) & FRESH))
+        return false;
+    previous = slots[front_index].frame;
+    front_index = middle.exchange(front_index, memory_order_acq_rel) & 3;
+    return true;
+}
+
+uint32_t const *TripleBuffer::front() {
+    return slots[front_index].pixels.data();
+}
+
+bool TripleBuffer::changed(int row) {
+    return slots[front_index].row_frames[row] > previous;
+}
@@ -0,0 +1,60 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+using namespace std;
+
+// Hands finished frames from one thread to another without locks or
+// waiting. The writer always has a buffer of its own to draw in and the
+// reader always has one to show; the third holds the newest finished frame
+// and the two sides swap theirs with it. The reader never sees a frame
+// that's half drawn, and if it falls behind it just skips to the newest.
+//
+// Each row also carries the number of the frame it last changed in, so the
+// reader can tell which rows differ from the last frame it took even when
+// it skipped some in between.
+class TripleBuffer {
+public:
+    TripleBuffer(int width, int height);
+
+    // writer: the buffer to draw the next frame in, and handing it over
+    // along with which rows changed since the last one handed over
+    uint32_t *back();
+    void publish(bool const *changed_rows);
+
+    // reader: takes the newest frame if there's one it hasn't seen, and
+    // returns whether there was
+    bool update();
+    uint32_t const *front();
+    // whether a row of the front frame differs from the frame the reader
+    // had before its last update
+    bool changed(int row);
+
+private:
+    struct Slot {
+        vector<uint32_t> pixels;
+        vector<uint64_t> row_frames;
+        uint64_t frame = 0;
+    };
+    Slot slots[3];
+    int height;
+
+    // index of the middle slot, plus FRESH if it hasn't been read yet
+    atomic<int> middle;
+    int back_index = 0;
+    int front_index = 2;
+
+    // the writer's frame count and when each row last changed
+    uint64_t frame = 0;
+    vector<uint64_t> row_frames;
+    // the frame the reader had before the front one
+    uint64_t previous = 0;
+
+    static int const FRESH = 4;
+};
+
+#endif
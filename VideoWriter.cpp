@@ -0,0 +1,175 @@
+#include "VideoWriter.h"
+#include <string.h>
+
+#define VIDEO_WIDTH 160
+#define VIDEO_HEIGHT 144
+#define VIDEO_PIXELS (VIDEO_WIDTH * VIDEO_HEIGHT)
+
+VideoWriter::VideoWriter() {
+}
+
+VideoWriter::~VideoWriter() {
+    close();
+}
+
+int VideoWriter::open(string file) {
+    close();
+
+    this->file = fopen(file.c_str(), "wb");
+    if (this->file == NULL) {
+        printf("Couldn't open %s for video\n", file.c_str());
+        return 1;
+    }
+    timing = fopen((file + ".timing").c_str(), "w");
+    if (timing == NULL) {
+        printf("Couldn't open %s.timing\n", file.c_str());
+        fclose(this->file);
+        this->file = NULL;
+        return 1;
+    }
+
+    y4m = file.size() >= 4 && file.compare(file.size() - 4, 4, ".y4m") == 0;
+    if (y4m) {
+        // the exact frame rate, 4194304 dots a second over 70224 a frame
+        fprintf(this->file, "YUV4MPEG2 W%d H%d F4194304:70224 Ip A1:1 C444 XCOLORRANGE=FULL\n",
+                VIDEO_WIDTH, VIDEO_HEIGHT);
+    }
+    fprintf(timing, "# video frame, emulated frame, frames dropped just before it\n");
+
+    failed = false;
+    have_last = false;
+    written = repeated = dropped = dropped_since = 0;
+    end_frame = 0;
+    last.resize(VIDEO_PIXELS);
+    queue.resize(QUEUE_FRAMES);
+    for (Slot &slot : queue)
+        slot.pixels.resize(VIDEO_PIXELS);
+    head = tail = 0;
+    done = false;
+    video_frame = 0;
+    encoded.resize(3 * VIDEO_PIXELS);
+    writer = thread(&VideoWriter::loop, this);
+    return 0;
+}
+
+void VideoWriter::setWait(bool enabled) {
+    wait = enabled;
+}
+
+void VideoWriter::write(uint32_t const *argb, uint64_t frame) {
+    if (file == NULL)
+        return;
+
+    end_frame = frame + 1;
+    if (have_last && memcmp(last.data(), argb, VIDEO_PIXELS * sizeof(uint32_t)) == 0) {
+        repeated++;
+        return;
+    }
+
+    // the lock is only ever held for a moment, never across a disk write
+    unique_lock<mutex> guard(lock);
+    if (wait)
+        space.wait(guard, [this] { return tail - head < QUEUE_FRAMES; });
+    if (tail - head == QUEUE_FRAMES) {
+        // the same picture is still what the video shows, so a later
+        // repeat of it mustn't be skipped as if it had been written
+        dropped++;
+        dropped_since++;
+        have_last = false;
+        return;
+    }
+    Slot &slot = queue[tail % QUEUE_FRAMES];
+    guard.unlock();
+
+    memcpy(slot.pixels.data(), argb, VIDEO_PIXELS * sizeof(uint32_t));
+    slot.frame = frame;
+    slot.dropped_before = dropped_since;
+    memcpy(last.data(), argb, VIDEO_PIXELS * sizeof(uint32_t));
+    have_last = true;
+    dropped_since = 0;
+    written++;
+
+    guard.lock();
+    tail++;
+    ready.notify_all();
+}
+
+static inline uint8_t clamp(int v) {
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+// Y4M gets BT.601 at full range, which the header says; raw is R, G, B.
+void VideoWriter::encode(Slot const &slot) {
+    uint32_t const *pixels = slot.pixels.data();
+    uint8_t *out = encoded.data();
+    if (y4m) {
+        uint8_t *Y = out, *U = out + VIDEO_PIXELS, *V = out + 2 * VIDEO_PIXELS;
+        for (int i=0; i<VIDEO_PIXELS; i++) {
+            int R = (pixels[i] >> 16) & 0xff, G = (pixels[i] >> 8) & 0xff, B = pixels[i] & 0xff;
+            Y[i] = clamp((77 * R + 150 * G + 29 * B + 128) >> 8);
+            U[i] = clamp(((-43 * R - 85 * G + 128 * B + 128) >> 8) + 128);
+            V[i] = clamp(((128 * R - 107 * G - 21 * B + 128) >> 8) + 128);
+        }
+    } else {
+        for (int i=0; i<VIDEO_PIXELS; i++) {
+            out[3*i]   = pixels[i] >> 16;
+            out[3*i+1] = pixels[i] >> 8;
+            out[3*i+2] = pixels[i];
+        }
+    }
+}
+
+void VideoWriter::loop() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        ready.wait(guard, [this] { return head != tail || done; });
+        if (head == tail)
+            return;
+
+        // the slot at head stays the writer's until head moves past it
+        Slot const &slot = queue[head % QUEUE_FRAMES];
+        guard.unlock();
+        encode(slot);
+        bool ok = true;
+        if (y4m)
+            ok = fputs("FRAME\n", file) >= 0;
+        ok = ok && fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size();
+        ok = ok && fprintf(timing, "%llu %llu %llu\n", (unsigned long long)video_frame,
+                           (unsigned long long)slot.frame, (unsigned long long)slot.dropped_before) > 0;
+        video_frame++;
+        guard.lock();
+        if (!ok)
+            failed = true;
+        head++;
+        space.notify_all();
+    }
+}
+
+int VideoWriter::close() {
+    if (file == NULL)
+        return 0;
+
+    {
+        lock_guard<mutex> guard(lock);
+        done = true;
+    }
+    ready.notify_all();
+    writer.join();
+
+    // where the last frame ends, so its length is known too
+    fprintf(timing, "# end %llu\n", (unsigned long long)end_frame);
+    if (fclose(file) != 0)
+        failed = true;
+    if (fclose(timing) != 0)
+        failed = true;
+    file = NULL;
+    timing = NULL;
+
+    printf("Video: %llu frames written, %llu repeats skipped, %llu dropped\n",
+           (unsigned long long)written, (unsigned long long)repeated, (unsigned long long)dropped);
+    if (failed) {
+        printf("Couldn't write all of the video\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+#ifndef VIDEO_WRITER_H
+#define VIDEO_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// Records frames to a file on a thread of its own, for capturing long runs
+// without a screen recorder. Files ending in .y4m get YUV4MPEG2 (4:4:4, so
+// no color is lost to subsampling), anything else raw 8-bit RGB.
+//
+// A frame that's the same as the one before isn't written again. Instead
+// file.timing gets a line for every frame that is written, saying which
+// emulated frame it is, so players and scripts can work out how long each
+// one stayed on screen. The emulator never waits for the disk: frames go
+// into a queue of QUEUE_FRAMES, and if that's full the frame is dropped
+// and the drop is noted in the timing file (unless it's told to wait).
+class VideoWriter {
+public:
+    VideoWriter();
+    ~VideoWriter();
+    int open(string file);
+    // waits for room in the queue instead of dropping frames, for when
+    // nothing has to keep time
+    void setWait(bool enabled);
+    // frame is the number of the emulated frame, counting from 0
+    void write(uint32_t const *argb, uint64_t frame);
+    int close();
+
+    static int const QUEUE_FRAMES = 64;
+
+private:
+    FILE *file = NULL;
+    FILE *timing = NULL;
+    bool y4m = false;
+    bool failed = false;
+    bool wait = false;
+
+    // the last frame queued, to skip repeats
+    vector<uint32_t> last;
+    bool have_last = false;
+    uint64_t end_frame = 0;
+    uint64_t written = 0;
+    uint64_t repeated = 0;
+    uint64_t dropped = 0;
+    uint64_t dropped_since = 0;
+
+    // a ring of QUEUE_FRAMES frames; the emulator fills slots at tail,
+    // the writer thread empties them from head
+    struct Slot {
+        vector<uint32_t> pixels;
+        uint64_t frame;
+        uint64_t dropped_before;
+    };
+    vector<Slot> queue;
+    size_t head = 0;
+    size_t tail = 0;
+    thread writer;
+    mutex lock;
+    condition_variable ready;
+    condition_variable space;
+    bool done = false;
+
+    // used only by the writer thread
+    vector<uint8_t> encoded;
+    uint64_t video_frame = 0;
+    void loop();
+    void encode(Slot const &slot);
+};
+
+#endif
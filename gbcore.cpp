@@ -0,0 +1,244 @@
+#include "gbcore.h"
+#include "Emulator.h"
+#include "BatchRunner.h"
+
+struct gb_emulator {
+    Emulator *emu;
+};
+
+struct gb_ram_spec {
+    RamSpec spec;
+};
+
+struct gb_search {
+    RamSearch *search;
+};
+
+struct gb_batch {
+    BatchRunner *runner;
+};
+
+gb_emulator *gb_create(uint8_t const *rom, size_t rom_size,
+                       uint8_t const *boot, size_t boot_size, int color) {
+    shared_ptr<CartridgeImage> image = CartridgeImage::fromBytes(rom, rom_size, boot, boot_size, color != 0);
+    if (!image)
+        return NULL;
+
+    gb_emulator *gb = new gb_emulator;
+    gb->emu = new Emulator(color != 0);
+    if (gb->emu->start(image)) {
+        gb_destroy(gb);
+        return NULL;
+    }
+    return gb;
+}
+
+void gb_destroy(gb_emulator *gb) {
+    if (gb == NULL)
+        return;
+    delete gb->emu;
+    delete gb;
+}
+
+int gb_reset(gb_emulator *gb) {
+    return gb->emu->reset();
+}
+
+void gb_run_frame(gb_emulator *gb) {
+    gb->emu->runFrame(true);
+}
+
+int gb_run_cycles(gb_emulator *gb, int dots) {
+    return gb->emu->runCycles(dots);
+}
+
+void gb_set_buttons(gb_emulator *gb, uint8_t buttons) {
+    gb->emu->setButtons(buttons);
+}
+
+uint32_t const *gb_framebuffer(gb_emulator *gb) {
+    return gb->emu->getFramebuffer();
+}
+
+uint8_t const *gb_index_frame(gb_emulator *gb) {
+    return gb->emu->getIndexFrame();
+}
+
+uint64_t gb_frame_hash(gb_emulator *gb) {
+    return gb->emu->frameHash();
+}
+
+uint64_t gb_state_hash(gb_emulator *gb) {
+    return gb->emu->stateHash();
+}
+
+void gb_set_palette(gb_emulator *gb, int palette) {
+    gb->emu->setPalette(palette);
+}
+
+void gb_set_color_profile(gb_emulator *gb, int profile) {
+    gb->emu->setColorProfile(profile);
+}
+
+void gb_set_fixed_clock(gb_emulator *gb, int64_t seconds) {
+    gb->emu->setFixedClock(seconds);
+}
+
+int16_t const *gb_audio(gb_emulator *gb, size_t *frames) {
+    return gb->emu->getAudio(frames);
+}
+
+int gb_sample_rate(gb_emulator *gb) {
+    return gb->emu->getSampleRate();
+}
+
+void gb_set_audio(gb_emulator *gb, int enabled) {
+    gb->emu->setAudio(enabled != 0);
+}
+
+void gb_set_audio_hash(gb_emulator *gb, int enabled) {
+    gb->emu->setAudioHash(enabled != 0);
+}
+
+uint64_t gb_audio_hash(gb_emulator *gb) {
+    return gb->emu->getAudioHash();
+}
+
+void gb_set_audio_ratio(gb_emulator *gb, double ratio) {
+    gb->emu->setAudioRatio(ratio);
+}
+
+uint8_t gb_read(gb_emulator *gb, uint16_t address) {
+    return gb->emu->readMemory(address);
+}
+
+void gb_write(gb_emulator *gb, uint16_t address, uint8_t value) {
+    gb->emu->writeMemory(address, value);
+}
+
+gb_ram_spec *gb_ram_spec_create(void) {
+    return new gb_ram_spec;
+}
+
+void gb_ram_spec_destroy(gb_ram_spec *spec) {
+    delete spec;
+}
+
+int gb_ram_spec_add(gb_ram_spec *spec, uint16_t address, int type, int count, int bank) {
+    return spec->spec.add(address, type, count, bank);
+}
+
+size_t gb_ram_spec_size(gb_ram_spec const *spec) {
+    return spec->spec.size();
+}
+
+void gb_gather(gb_emulator *gb, gb_ram_spec const *spec, void *out) {
+    gb->emu->gather(spec->spec, (uint8_t*)out);
+}
+
+uint8_t const *gb_view(gb_emulator *gb, uint16_t address, int bank) {
+    return gb->emu->view(address, bank);
+}
+
+gb_search *gb_search_create(gb_emulator *gb) {
+    gb_search *search = new gb_search;
+    search->search = gb->emu->createSearch();
+    return search;
+}
+
+void gb_search_destroy(gb_search *search) {
+    if (search == NULL)
+        return;
+    delete search->search;
+    delete search;
+}
+
+void gb_search_reset(gb_search *search) {
+    search->search->reset();
+}
+
+size_t gb_search_filter(gb_search *search, int op, uint8_t value) {
+    return search->search->filter(op, value);
+}
+
+size_t gb_search_results(gb_search *search, uint16_t *addresses, int *banks,
+                         uint8_t *values, size_t max) {
+    vector<RamSearch::Result> found = search->search->results(max);
+    for (size_t i=0; i<found.size(); i++) {
+        if (addresses) addresses[i] = found[i].address;
+        if (banks) banks[i] = found[i].bank;
+        if (values) values[i] = found[i].value;
+    }
+    return found.size();
+}
+
+size_t gb_state_size(gb_emulator *gb) {
+    return gb->emu->stateSize();
+}
+
+int gb_save_state(gb_emulator *gb, void *buffer, size_t size) {
+    return gb->emu->saveState((uint8_t*)buffer, size);
+}
+
+int gb_load_state(gb_emulator *gb, void const *buffer, size_t size) {
+    return gb->emu->loadState((uint8_t const*)buffer, size);
+}
+
+gb_batch *gb_batch_create(uint8_t const *rom, size_t rom_size,
+                          uint8_t const *boot, size_t boot_size, int color,
+                          int num_envs, int num_threads) {
+    shared_ptr<CartridgeImage> image = CartridgeImage::fromBytes(rom, rom_size, boot, boot_size, color != 0);
+    if (!image)
+        return NULL;
+
+    gb_batch *batch = new gb_batch;
+    batch->runner = new BatchRunner(num_envs, color != 0, num_threads);
+    if (batch->runner->start(image)) {
+        gb_batch_destroy(batch);
+        return NULL;
+    }
+    return batch;
+}
+
+void gb_batch_destroy(gb_batch *batch) {
+    if (batch == NULL)
+        return;
+    delete batch->runner;
+    delete batch;
+}
+
+void gb_batch_set_observation(gb_batch *batch, int width, int height, int stack) {
+    batch->runner->setObservation(width, height, stack);
+}
+
+size_t gb_batch_observation_bytes(gb_batch *batch) {
+    return batch->runner->observationBytes();
+}
+
+void gb_batch_set_ram_spec(gb_batch *batch, gb_ram_spec const *spec) {
+    batch->runner->setRamSpec(spec->spec);
+}
+
+size_t gb_batch_ram_bytes(gb_batch *batch) {
+    return batch->runner->ramBytes();
+}
+
+void gb_batch_set_audio_hash(gb_batch *batch, int enabled) {
+    batch->runner->setAudioHash(enabled != 0);
+}
+
+void gb_batch_audio_hashes(gb_batch *batch, uint64_t *hashes) {
+    batch->runner->audioHashes(hashes);
+}
+
+void gb_batch_step(gb_batch *batch, uint8_t const *actions, void *observations, void *ram) {
+    batch->runner->step(actions, (uint8_t*)observations, (uint8_t*)ram);
+}
+
+int gb_batch_reset(gb_batch *batch, int env) {
+    return batch->runner->reset(env);
+}
+
+double gb_batch_frames_per_second(gb_batch *batch) {
+    return batch->runner->framesPerSecond();
+}
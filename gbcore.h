@@ -0,0 +1,172 @@
+#ifndef GBCORE_H
+#define GBCORE_H
+
+/* C interface to the emulator core, for embedding it in other programs.
+ * Each gb_emulator is independent; calls on different instances can run
+ * on different threads, calls on one instance can't. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gb_emulator gb_emulator;
+
+/* Buttons for gb_set_buttons, held while their bit is set. */
+#define GB_BUTTON_START  0x01
+#define GB_BUTTON_SELECT 0x02
+#define GB_BUTTON_B      0x04
+#define GB_BUTTON_A      0x08
+#define GB_BUTTON_DOWN   0x10
+#define GB_BUTTON_UP     0x20
+#define GB_BUTTON_LEFT   0x40
+#define GB_BUTTON_RIGHT  0x80
+
+#define GB_SCREEN_WIDTH  160
+#define GB_SCREEN_HEIGHT 144
+
+/* The ROM (and boot ROM) are copied, so the buffers can be freed after.
+ * With boot NULL the boot ROM is read from ../boot_roms like the player
+ * does. color picks Game Boy Color mode. Returns NULL on failure. */
+gb_emulator *gb_create(uint8_t const *rom, size_t rom_size,
+                       uint8_t const *boot, size_t boot_size, int color);
+void gb_destroy(gb_emulator *gb);
+int gb_reset(gb_emulator *gb);
+
+/* gb_run_cycles runs at least the given number of dots (T-cycles at
+ * normal speed) and returns how many ran. */
+void gb_run_frame(gb_emulator *gb);
+int gb_run_cycles(gb_emulator *gb, int dots);
+
+void gb_set_buttons(gb_emulator *gb, uint8_t buttons);
+
+/* 160x144 ARGB pixels, rows packed. The pointer stays valid for the life
+ * of the emulator and is rewritten in place by every frame. */
+uint32_t const *gb_framebuffer(gb_emulator *gb);
+/* The same picture as color indices, one byte per pixel: the shade (0-3)
+ * on a DMG, or on a CGB 0-31 for a BG palette color, 32-63 for an OBJ
+ * palette color and 64 for white. Colors are only worked out when
+ * gb_framebuffer is called, so this is the cheaper one to read. */
+uint8_t const *gb_index_frame(gb_emulator *gb);
+/* XXH64 of gb_framebuffer, and of everything a save state holds, for
+ * checking that two runs are identical frame by frame. */
+uint64_t gb_frame_hash(gb_emulator *gb);
+uint64_t gb_state_hash(gb_emulator *gb);
+/* Picks one of the 11 DMG color schemes, 0 being the default. */
+void gb_set_palette(gb_emulator *gb, int palette);
+
+/* How CGB colors are shown: as stored (the default), or made to look like
+ * the GBC's washed out LCD, the gamma one being the closer match. */
+#define GB_COLOR_RAW     0
+#define GB_COLOR_GBC_LCD 1
+#define GB_COLOR_GAMMA   2
+void gb_set_color_profile(gb_emulator *gb, int profile);
+/* Makes the cartridge clock (MBC3 RTC) start at this many seconds since
+ * 1970 UTC and follow emulated time instead of the wall clock, so runs
+ * that have to repeat exactly do. -1 goes back to the wall clock. */
+void gb_set_fixed_clock(gb_emulator *gb, int64_t seconds);
+
+/* Sound made by the last gb_run_frame/gb_run_cycles: *frames pairs of
+ * left/right samples at gb_sample_rate. With audio turned off the sound
+ * hardware still runs but no samples are made, which is cheaper. */
+int16_t const *gb_audio(gb_emulator *gb, size_t *frames);
+int gb_sample_rate(gb_emulator *gb);
+void gb_set_audio(gb_emulator *gb, int enabled);
+/* A hash of what the sound hardware did during the last frame, for
+ * checking that a run sounds the same as before. Turning it on costs less
+ * than making samples and works with audio off. */
+void gb_set_audio_hash(gb_emulator *gb, int enabled);
+uint64_t gb_audio_hash(gb_emulator *gb);
+/* Makes ratio times the samples per frame (a fraction of a percent either
+ * way) to keep an audio queue from running dry or overflowing. */
+void gb_set_audio_ratio(gb_emulator *gb, double ratio);
+
+uint8_t gb_read(gb_emulator *gb, uint16_t address);
+void gb_write(gb_emulator *gb, uint16_t address, uint8_t value);
+
+/* Game variables to read out of memory in one go. Each field is `count`
+ * elements of a type starting at address; bank picks the VRAM/WRAM/
+ * external RAM/ROM bank, -1 for whichever is mapped in. Fields are packed
+ * one after another in the order they were added: GB_U8 takes 1 byte per
+ * element, GB_U16LE 2 (little endian), and GB_BCD reads `count` (up to 4)
+ * bytes of BCD digits, most significant first, into one uint32.
+ * gb_ram_spec_add returns the field's byte offset, or -1. */
+#define GB_U8    0
+#define GB_U16LE 1
+#define GB_BCD   2
+
+typedef struct gb_ram_spec gb_ram_spec;
+
+gb_ram_spec *gb_ram_spec_create(void);
+void gb_ram_spec_destroy(gb_ram_spec *spec);
+int gb_ram_spec_add(gb_ram_spec *spec, uint16_t address, int type, int count, int bank);
+size_t gb_ram_spec_size(gb_ram_spec const *spec);
+void gb_gather(gb_emulator *gb, gb_ram_spec const *spec, void *out);
+
+/* Pointer straight at the byte behind an address, NULL if there is none.
+ * It stays valid while the game runs, but not across gb_load_state or
+ * gb_reset. */
+uint8_t const *gb_view(gb_emulator *gb, uint16_t address, int bank);
+
+/* Cheat finder over WRAM, HRAM and external RAM. Every byte starts out
+ * as a candidate; each filter keeps those that compare the right way
+ * against value (GB_SEARCH_EQUAL..LESS) or against what they were at the
+ * previous filter (GB_SEARCH_CHANGED..DECREASED), and returns how many
+ * are left. gb_search_results fills up to max candidates. */
+#define GB_SEARCH_EQUAL     0
+#define GB_SEARCH_NOT_EQUAL 1
+#define GB_SEARCH_GREATER   2
+#define GB_SEARCH_LESS      3
+#define GB_SEARCH_CHANGED   4
+#define GB_SEARCH_UNCHANGED 5
+#define GB_SEARCH_INCREASED 6
+#define GB_SEARCH_DECREASED 7
+
+typedef struct gb_search gb_search;
+
+gb_search *gb_search_create(gb_emulator *gb);
+void gb_search_destroy(gb_search *search);
+void gb_search_reset(gb_search *search);
+size_t gb_search_filter(gb_search *search, int op, uint8_t value);
+size_t gb_search_results(gb_search *search, uint16_t *addresses, int *banks,
+                         uint8_t *values, size_t max);
+
+/* Save states are plain buffers of gb_state_size bytes. The save and load
+ * functions return 0 on success. */
+size_t gb_state_size(gb_emulator *gb);
+int gb_save_state(gb_emulator *gb, void *buffer, size_t size);
+int gb_load_state(gb_emulator *gb, void const *buffer, size_t size);
+
+/* A batch of copies of one game run on a thread pool, one frame per step.
+ * actions has one button byte per game; observations gets the games'
+ * observations back to back, gb_batch_observation_bytes each, and ram
+ * (if not NULL) the variables of a gb_batch_set_ram_spec spec, packed the
+ * same way as gb_gather, gb_batch_ram_bytes each. By default
+ * an observation is the ARGB frame; gb_batch_set_observation switches to
+ * grayscale shrunk to width x height, with the last `stack` frames one
+ * after another (oldest first). num_threads 0 means one per core. */
+typedef struct gb_batch gb_batch;
+
+gb_batch *gb_batch_create(uint8_t const *rom, size_t rom_size,
+                          uint8_t const *boot, size_t boot_size, int color,
+                          int num_envs, int num_threads);
+void gb_batch_destroy(gb_batch *batch);
+void gb_batch_set_observation(gb_batch *batch, int width, int height, int stack);
+size_t gb_batch_observation_bytes(gb_batch *batch);
+void gb_batch_set_ram_spec(gb_batch *batch, gb_ram_spec const *spec);
+size_t gb_batch_ram_bytes(gb_batch *batch);
+/* With audio hashing on, gb_batch_audio_hashes gives one gb_audio_hash per
+ * game for the last step. */
+void gb_batch_set_audio_hash(gb_batch *batch, int enabled);
+void gb_batch_audio_hashes(gb_batch *batch, uint64_t *hashes);
+void gb_batch_step(gb_batch *batch, uint8_t const *actions, void *observations, void *ram);
+int gb_batch_reset(gb_batch *batch, int env);
+double gb_batch_frames_per_second(gb_batch *batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
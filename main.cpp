@@ -1,16 +1,92 @@
-#include "PPU.h"
 #include "Emulator.h"
+#include "Frontend.h"
+#include "Benchmark.h"
+#include "Headless.h"
+#include "Regression.h"
 #include <thread>
 #include <stdio.h>
 
 int main(int argc, char** argv) {
     bool color_on = false;
+    int save_interval = 1000;
+    int rewind_budget = 64;
+    int run_ahead = 0;
+    int audio_latency = 20;
+    double speed = 1.0;
+    bool vsync = false;
+    int frame_skip = -1;
+    int color_profile = COLOR_RAW;
+    int scaler = SCALER_NONE;
+    int headless_frames = 0;
+    string audio_file;
+    string video_file;
+    string movie_file;
+    string regression_dir;
+    bool debug = false;
+    string benchmark;
     for (int i=1; i<argc-1; i++) {
         if (argv[i][1] == 'c') color_on = true;
+        if (argv[i][1] == 'd') debug = true;
+        if (argv[i][1] == 's' && i+1 < argc-1) save_interval = atoi(argv[++i]);
+        if (argv[i][1] == 'r' && i+1 < argc-1) rewind_budget = atoi(argv[++i]);
+        if (argv[i][1] == 'a' && i+1 < argc-1) run_ahead = atoi(argv[++i]);
+        if (argv[i][1] == 'b' && i+1 < argc-1) benchmark = argv[++i];
+        if (argv[i][1] == 'l' && i+1 < argc-1) audio_latency = atoi(argv[++i]);
+        if (argv[i][1] == 'x' && i+1 < argc-1) speed = atof(argv[++i]);
+        if (argv[i][1] == 'v') vsync = true;
+        if (argv[i][1] == 'k' && i+1 < argc-1) frame_skip = atoi(argv[++i]);
+        if (argv[i][1] == 'p' && i+1 < argc-1) color_profile = atoi(argv[++i]);
+        if (argv[i][1] == 'z' && i+1 < argc-1) {
+            scaler = Scaler::find(argv[++i]);
+            if (scaler < 0) {
+                printf("Unknown scaler %s\n", argv[i]);
+                return 1;
+            }
+        }
+        if (argv[i][1] == 'f' && i+1 < argc-1) headless_frames = atoi(argv[++i]);
+        if (argv[i][1] == 'w' && i+1 < argc-1) audio_file = argv[++i];
+        if (argv[i][1] == 'y' && i+1 < argc-1) video_file = argv[++i];
+        if (argv[i][1] == 'm' && i+1 < argc-1) movie_file = argv[++i];
     }
 
+    if (!benchmark.empty())
+        return Benchmark::run(benchmark, argv[argc-1], color_on);
+    // -t [folder] is the last argument, in place of the game
+    if (argc >= 3 && string(argv[argc-2]) == "-t")
+        return Regression::run(argv[argc-1], color_on, headless_frames > 0 ? headless_frames : 3600);
+
     Emulator *emu = new Emulator(color_on);
-    emu->run(argv[argc-1]);
+    emu->setSaveInterval(save_interval);
+    emu->setRewindBudget(rewind_budget);
+    emu->setRunAhead(run_ahead);
+    if (debug)
+        emu->setDebug();
+
+    // -f [frames] (and -w [file], which defaults to a minute) run without
+    // a window
+    if (headless_frames > 0 || !audio_file.empty()) {
+        Headless *headless = new Headless(emu);
+        headless->setAudioFile(audio_file);
+        headless->setVideoFile(video_file);
+        headless->setMovieFile(movie_file);
+        int result = headless->run(argv[argc-1], headless_frames > 0 ? headless_frames : 3600);
+        delete headless;
+        delete emu;
+        return result;
+    }
+
+    Frontend *frontend = new Frontend(emu);
+    frontend->setAudioLatency(audio_latency);
+    frontend->setSpeed(speed);
+    frontend->setVsync(vsync);
+    frontend->setFrameSkip(frame_skip);
+    frontend->setColorProfile(color_profile);
+    frontend->setScaler(scaler);
+    frontend->setVideoFile(video_file);
+    frontend->setMovieFile(movie_file);
+    int result = frontend->run(argv[argc-1]);
 
+    delete frontend;
     delete emu;
+    return result;
 }
\ No newline at end of file